@@ -1,6 +1,7 @@
 // Implements the CascadeEnrich class
 #include "CascadeEnrich.h"
 #include "behavior_functions.h"
+#include "cascade_cache.h"
 #include "enrich_functions.h"
 #include "sim_init.h"
 
@@ -32,6 +33,10 @@ namespace mbmore {
   feed_commod(""),
   product_commod(""),
   tails_commod(""),
+  tails_merge_interval(0),
+  tails_max_lots(0),
+  tails_bin_width(1e-4),
+  record_interval(0),
   order_prefs(true) {}
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 CascadeEnrich::~CascadeEnrich() {}
@@ -55,42 +60,50 @@ void CascadeEnrich::Build(cyclus::Agent* parent) {
 
   tails_assay = design_tails_assay;
   
-  // Calculate ideal machine performance
-  double design_delU = CalcDelU(centrifuge_velocity, height, diameter,
-				Mg2kgPerSec(machine_feed), temp,
-				cut, eff, M, dM, x, flow_internal);
-  double design_alpha = AlphaBySwu(design_delU, Mg2kgPerSec(machine_feed),
-				   cut, M);
-
-  // Design ideal cascade based on target feed flow and product assay
-  std::pair<int, int> n_stages =
-    FindNStages(design_alpha, design_feed_assay, design_product_assay,
-		design_tails_assay);
-
-  // TODO DELETE THIS, STAGES ARE ALREADY INTS
+  // Design ideal cascade based on the machine parameters, target assays and
+  // available centrifuges. Identical facilities share one cached design.
+  CascadeDesignKey key;
+  key.v_a = centrifuge_velocity;
+  key.height = height;
+  key.diameter = diameter;
+  key.machine_feed = Mg2kgPerSec(machine_feed);
+  key.temp = temp;
+  key.feed_assay = design_feed_assay;
+  key.product_assay = design_product_assay;
+  key.tails_assay = design_tails_assay;
+  key.max_centrifuges = max_centrifuges;
+  key.cut = cut;
+  key.eff = eff;
+  key.M = M;
+  key.dM = dM;
+  key.x = x;
+  key.flow_internal = flow_internal;
+
+  CascadeDesign design = CascadeDesignCache::Instance().Get(key);
+
   // set as internal state variables
-  // int truncates but we need # of stages to assure target values,
-  // so if the number is 5.1 we need 6. 
-  //  n_enrich_stages = int(n_stages.first) + 1;
-  //  n_strip_stages = int(n_stages.second) + 1;
-  n_enrich_stages = n_stages.first;
-  n_strip_stages = n_stages.second;
-
-  std::pair<int,double> cascade_info = DesignCascade(FlowPerSec(design_feed_flow),
-						     design_alpha,
-						     design_delU,
-						     cut, max_centrifuges,
-						     n_stages);
-
-  max_feed_inventory = FlowPerMon(cascade_info.second);
+  design_delU = design.delU;
+  design_alpha = design.alpha;
+  n_enrich_stages = design.n_stages.first;
+  n_strip_stages = design.n_stages.second;
+
+  // A facility without centrifuges has no stages to run off-design
+  if (design.n_machines > 0) {
+    stage_table = BuildStageTable(design_feed_assay, design_alpha,
+                                  design_delU, cut, design.n_stages,
+                                  design.feed_flow);
+  }
+
+  max_feed_inventory = FlowPerMon(design.feed_flow);
   // Number of machines times swu per machine
-  SwuCapacity(cascade_info.first * FlowPerMon(design_delU));
+  SwuCapacity(design.n_machines * FlowPerMon(design_delU));
 
   Facility::Build(parent);
   if (initial_feed > 0) {
-    inventory.Push(
-      Material::Create(
-        this, initial_feed, context()->GetRecipe(feed_recipe)));
+    Material::Ptr feed =
+        Material::Create(this, initial_feed, context()->GetRecipe(feed_recipe));
+    inventory.Push(feed);
+    feed_tally_.Add(feed);
   }
   
   LOG(cyclus::LEV_DEBUG2, "EnrFac") << "CascadeEnrich "
@@ -116,6 +129,20 @@ void CascadeEnrich::Tock() {
                                    << intra_timestep_feed_ << " feed";
   RecordTimeSeries<cyclus::toolkit::ENRICH_FEED>(this, intra_timestep_feed_);
 
+  // one tails lot is added per trade, merge them to keep the buffer bounded
+  if (((tails_merge_interval > 0) &&
+       (context()->time() % tails_merge_interval == 0)) ||
+      ((tails_max_lots > 0) && (tails.count() > tails_max_lots))) {
+    ConsolidateLots(&tails, tails_bin_width);
+  }
+
+  // trades are only summarized when record_interval > 0
+  if ((record_interval > 0) &&
+      SummaryDue(context()->time(), record_interval,
+                 context()->sim_info().duration)) {
+    RecordSummary_();
+  }
+
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -142,10 +169,6 @@ CascadeEnrich::GetMatlRequests() {
 //  U-235 content
 void CascadeEnrich::AdjustMatlPrefs(
     cyclus::PrefMap<cyclus::Material>::type& prefs) {
-  using cyclus::Bid;
-  using cyclus::Material;
-  using cyclus::Request;
-
   if (order_prefs == false) {
     return;
   }
@@ -154,35 +177,8 @@ void CascadeEnrich::AdjustMatlPrefs(
 
   // Loop over all requests
   for (reqit = prefs.begin(); reqit != prefs.end(); ++reqit) {
-    std::vector<Bid<Material>*> bids_vector;
-    std::map<Bid<Material>*, double>::iterator mit;
-    for (mit = reqit->second.begin(); mit != reqit->second.end(); ++mit) {
-      Bid<Material>* bid = mit->first;
-      bids_vector.push_back(bid);
-    }
-
-    std::sort(bids_vector.begin(), bids_vector.end(), SortBids);
-
-    // Assign preferences to the sorted vector
-    double n_bids = bids_vector.size();
-    bool u235_mass = 0;
-
-    for (int bidit = 0; bidit < bids_vector.size(); bidit++) {
-      int new_pref = bidit + 1;
-
-      // For any bids with U-235 qty=0, set pref to zero.
-      if (!u235_mass) {
-        cyclus::Material::Ptr mat = bids_vector[bidit]->offer();
-        cyclus::toolkit::MatQuery mq(mat);
-        if (mq.mass(922350000) == 0) {
-          new_pref = -1;
-        } else {
-          u235_mass = true;
-        }
-      }
-      (reqit->second)[bids_vector[bidit]] = new_pref;
-    }  // each bid
-  }    // each Material Request
+    RankBidsByU235(&reqit->second);
+  }
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -200,25 +196,13 @@ void CascadeEnrich::AcceptMatlTrades(
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void CascadeEnrich::AddMat_(cyclus::Material::Ptr mat) {
   // Elements and isotopes other than U-235, U-238 are sent directly to tails
-  cyclus::CompMap cm = mat->comp()->atom();
-  bool extra_u = false;
-  bool other_elem = false;
-  for (cyclus::CompMap::const_iterator it = cm.begin(); it != cm.end(); ++it) {
-    if (pyne::nucname::znum(it->first) == 92) {
-      if (pyne::nucname::anum(it->first) != 235 &&
-          pyne::nucname::anum(it->first) != 238 && it->second > 0) {
-        extra_u = true;
-      }
-    } else if (it->second > 0) {
-      other_elem = true;
-    }
-  }
-  if (extra_u) {
+  CompProperties props = CompProps(mat);
+  if (props.extra_u) {
     cyclus::Warn<cyclus::VALUE_WARNING>(
         "More than 2 isotopes of U.  "
         "Istopes other than U-235, U-238 are sent directly to tails.");
   }
-  if (other_elem) {
+  if (props.other_elem) {
     cyclus::Warn<cyclus::VALUE_WARNING>(
         "Non-uranium elements are "
         "sent directly to tails.");
@@ -229,6 +213,7 @@ void CascadeEnrich::AddMat_(cyclus::Material::Ptr mat) {
 
   try {
     inventory.Push(mat);
+    feed_tally_.Add(mat);
   } catch (cyclus::Error& e) {
     e.msg(Agent::InformErrorMsg(e.msg()));
     throw e;
@@ -257,12 +242,14 @@ CascadeEnrich::GetMatlBids(cyclus::CommodMap<cyclus::Material>::type& out_reques
 
     std::vector<Request<Material>*>& tails_requests =
         out_requests[tails_commod];
+    // offer bids for all tails material, keeping discrete quantities
+    // to preserve possible variation in composition. The lots are read
+    // once and the same offers are shared by every tails request.
+    MatVec mats = tails.PopN(tails.count());
+    tails.Push(mats);
+
     std::vector<Request<Material>*>::iterator it;
     for (it = tails_requests.begin(); it != tails_requests.end(); ++it) {
-      // offer bids for all tails material, keeping discrete quantities
-      // to preserve possible variation in composition
-      MatVec mats = tails.PopN(tails.count());
-      tails.Push(mats);
       for (int k = 0; k < mats.size(); k++) {
         Material::Ptr m = mats[k];
         Request<Material>* req = *it;
@@ -282,25 +269,41 @@ CascadeEnrich::GetMatlBids(cyclus::CommodMap<cyclus::Material>::type& out_reques
   if ((out_requests.count(product_commod) > 0) && (inventory.quantity() > 0)) {
     BidPortfolio<Material>::Ptr commod_port(new BidPortfolio<Material>());
 
+    // The designed stages set the tails, the highest product that can be
+    // made from the current feed, and how much feed and SWU the machines
+    // can actually deliver
+    double feed_assay = FeedAssay();
+    OperatingPoint op = OperatingPoint_(feed_assay);
+    if (op.efficiency <= 0) {
+      LOG(cyclus::LEV_INFO5, "EnrFac")
+          << prototype() << " cannot enrich feed of assay " << feed_assay;
+      return ports;
+    }
+    double max_product = op.max_product;
+    double swu_limit = swu_capacity * op.efficiency;
+    double natu_limit = std::min(inventory.quantity(), op.max_feed);
+
     std::vector<Request<Material>*>& commod_requests =
         out_requests[product_commod];
     std::vector<Request<Material>*>::iterator it;
     for (it = commod_requests.begin(); it != commod_requests.end(); ++it) {
       Request<Material>* req = *it;
       Material::Ptr mat = req->target();
-      double request_enrich = cyclus::toolkit::UraniumAssay(mat);
+      double request_enrich = CompProps(mat).assay;
       if (ValidReq(req->target()) &&
-          ((request_enrich < max_enrich) ||
-           (cyclus::AlmostEq(request_enrich, max_enrich)))) {
+          ((request_enrich < max_product) ||
+           (cyclus::AlmostEq(request_enrich, max_product)))) {
         Material::Ptr offer = Offer_(req->target());
         commod_port->AddBid(req, offer, this);
       }
     }
 
-    Converter<Material>::Ptr sc(new SWUConverter(FeedAssay(), tails_assay));
-    Converter<Material>::Ptr nc(new NatUConverter(FeedAssay(), tails_assay));
-    CapacityConstraint<Material> swu(swu_capacity, sc);
-    CapacityConstraint<Material> natu(inventory.quantity(), nc);
+    Converter<Material>::Ptr sc(
+        new SWUConverter(feed_assay, op.tails_assay));
+    Converter<Material>::Ptr nc(
+        new NatUConverter(feed_assay, op.tails_assay));
+    CapacityConstraint<Material> swu(swu_limit, sc);
+    CapacityConstraint<Material> natu(natu_limit, nc);
     commod_port->AddConstraint(swu);
     commod_port->AddConstraint(natu);
 
@@ -313,6 +316,69 @@ CascadeEnrich::GetMatlBids(cyclus::CommodMap<cyclus::Material>::type& out_reques
   return ports;
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+namespace {
+// Moves assay by the same change in abundance ratio N/(1-N) as from -> to
+double ShiftAssay(double assay, double from, double to) {
+  double ratio = (assay / (1 - assay)) * (to / (1 - to)) * ((1 - from) / from);
+  return ratio / (1 + ratio);
+}
+}  // namespace
+
+// The stage table is built from whole stages, so its product is richer and
+// its tails leaner than the design assays by less than one stage (a factor
+// alpha in abundance ratio). Off the design point the tails and product are
+// therefore moved from the design values by the change the stage table
+// solution predicts, and the highest product is also limited by max_enrich.
+// They differ from the stage table solution for the same feed by that fixed
+// whole-stage offset: the product is up to one stage leaner and the tails up
+// to one stage richer, in abundance ratio.
+CascadeEnrich::OperatingPoint CascadeEnrich::OperatingPoint_(
+    double feed_assay) {
+  OperatingPoint op;
+  op.max_product = max_enrich;
+  op.tails_assay = tails_assay;
+  op.efficiency = 1.0;
+  op.max_feed = std::numeric_limits<double>::max();
+  if (!OffDesign_(feed_assay)) {
+    return op;
+  }
+
+  const CascadePerformance& perf = Performance_(feed_assay);
+  op.max_product = std::min(
+      max_enrich, ShiftAssay(design_product_assay, stage_table.ProductAssay(),
+                             perf.product_assay));
+  op.tails_assay =
+      ShiftAssay(tails_assay, stage_table.TailsAssay(), perf.tails_assay);
+  op.efficiency = perf.efficiency;
+  op.max_feed = FlowPerMon(perf.max_feed_flow);
+  return op;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool CascadeEnrich::OffDesign_(double feed_assay) const {
+  if (stage_table.empty() || !(feed_assay > 0) || !(feed_assay < 1)) {
+    return false;
+  }
+  return std::fabs(feed_assay - design_feed_assay) >
+         design_feed_tolerance * design_feed_assay;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Solved once per feed assay bucket at the bucket's central assay
+const CascadePerformance& CascadeEnrich::Performance_(double feed_assay) {
+  int feed_bin = static_cast<int>(std::floor(feed_assay / assay_bucket));
+  std::map<int, CascadePerformance>::iterator it =
+      performance_cache_.find(feed_bin);
+  if (it == performance_cache_.end()) {
+    double bin_assay = (feed_bin + 0.5) * assay_bucket;
+    it = performance_cache_.insert(std::make_pair(
+        feed_bin, SolveOffDesign(stage_table, bin_assay,
+                                 stage_table.cascade_feed))).first;
+  }
+  return it->second;
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void CascadeEnrich::GetMatlTrades(
     const std::vector<cyclus::Trade<cyclus::Material> >& trades,
@@ -365,40 +431,36 @@ cyclus::Material::Ptr CascadeEnrich::Enrich_(cyclus::Material::Ptr mat,
   using cyclus::Material;
   using cyclus::ResCast;
   using cyclus::toolkit::Assays;
-  using cyclus::toolkit::UraniumAssay;
   using cyclus::toolkit::SwuRequired;
   using cyclus::toolkit::FeedQty;
   using cyclus::toolkit::TailsQty;
 
-  // get enrichment parameters
-  Assays assays(FeedAssay(), UraniumAssay(mat), tails_assay);
-  double swu_req = SwuRequired(qty, assays);
+  // get enrichment parameters. Off the design point the tails come from the
+  // built stages, and the machines spend more separative work than the
+  // ideal amount because mismatched streams are mixed between stages.
+  double feed_assay = FeedAssay();
+  OperatingPoint op = OperatingPoint_(feed_assay);
+  if (op.efficiency <= 0) {
+    std::stringstream ss;
+    ss << " cannot do separative work on feed of assay " << feed_assay;
+    throw cyclus::ValueError(Agent::InformErrorMsg(ss.str()));
+  }
+  Assays assays(feed_assay, CompProps(mat).assay, op.tails_assay);
+  double swu_req = SwuRequired(qty, assays) / op.efficiency;
   double natu_req = FeedQty(qty, assays);
 
   // Determine the composition of the natural uranium
   // (ie. U-235+U-238/TotalMass)
-  double pop_qty = inventory.quantity();
-  Material::Ptr natu_matl = inventory.Pop(pop_qty, cyclus::eps_rsrc());
-  inventory.Push(natu_matl);
-
-  cyclus::toolkit::MatQuery mq(natu_matl);
-  std::set<cyclus::Nuc> nucs;
-  nucs.insert(922350000);
-  nucs.insert(922380000);
-  double natu_frac = mq.mass_frac(nucs);
+  SyncFeedTally_();
+  double natu_frac = feed_tally_.UraniumFraction();
   double feed_req = natu_req / natu_frac;
 
-  // pop amount from inventory and blob it into one material
+  // pop exactly the feed needed from inventory, as one material
   Material::Ptr r;
   try {
-    // required so popping doesn't take out too much
-    if (cyclus::AlmostEq(feed_req, inventory.quantity())) {
-      r = cyclus::toolkit::Squash(inventory.PopN(inventory.count()));
-    } else {
-      r = inventory.Pop(feed_req, cyclus::eps_rsrc());
-    }
+    r = WithdrawFeed(&inventory, &feed_tally_, feed_req);
   } catch (cyclus::Error& e) {
-    NatUConverter nc(FeedAssay(), tails_assay);
+    NatUConverter nc(feed_assay, op.tails_assay);
     std::stringstream ss;
     ss << " tried to remove " << feed_req << " from its inventory of size "
        << inventory.quantity()
@@ -447,6 +509,11 @@ void CascadeEnrich::RecordEnrichment_(double natural_u, double swu) {
   LOG(cyclus::LEV_DEBUG1, "EnrFac") << "  * Amount: " << natural_u;
   LOG(cyclus::LEV_DEBUG1, "EnrFac") << "  *    SWU: " << swu;
 
+  if (record_interval > 0) {
+    trade_summary_.Add(natural_u, swu);
+    return;
+  }
+
   Context* ctx = Agent::context();
   ctx->NewDatum("Enrichments")
       ->AddVal("ID", id())
@@ -456,6 +523,24 @@ void CascadeEnrich::RecordEnrichment_(double natural_u, double swu) {
       ->Record();
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void CascadeEnrich::RecordSummary_() {
+  if (!trade_summary_.empty()) {
+    context()->NewDatum("EnrichmentsSummary")
+        ->AddVal("ID", id())
+        ->AddVal("Time", context()->time())
+        ->AddVal("NTrades", trade_summary_.n_trades())
+        ->AddVal("Natural_Uranium", trade_summary_.natu_sum())
+        ->AddVal("Natural_Uranium_Min", trade_summary_.natu_min())
+        ->AddVal("Natural_Uranium_Max", trade_summary_.natu_max())
+        ->AddVal("SWU", trade_summary_.swu_sum())
+        ->AddVal("SWU_Min", trade_summary_.swu_min())
+        ->AddVal("SWU_Max", trade_summary_.swu_max())
+        ->Record();
+  }
+  trade_summary_.Clear();
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 cyclus::Material::Ptr CascadeEnrich::Request_() {
   double qty = std::max(0.0, inventory.capacity() - inventory.quantity());
@@ -464,32 +549,38 @@ cyclus::Material::Ptr CascadeEnrich::Request_() {
 }
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 cyclus::Material::Ptr CascadeEnrich::Offer_(cyclus::Material::Ptr mat) {
-  cyclus::toolkit::MatQuery q(mat);
+  CompProperties props = CompProps(mat);
   cyclus::CompMap comp;
-  comp[922350000] = q.atom_frac(922350000);
-  comp[922380000] = q.atom_frac(922380000);
+  comp[922350000] = props.u235_atom_frac;
+  comp[922380000] = props.u238_atom_frac;
   return cyclus::Material::CreateUntracked(
       mat->quantity(), cyclus::Composition::CreateFromAtom(comp));
 }
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 bool CascadeEnrich::ValidReq(const cyclus::Material::Ptr mat) {
-  cyclus::toolkit::MatQuery q(mat);
-  double u235 = q.atom_frac(922350000);
-  double u238 = q.atom_frac(922380000);
-  return (u238 > 0 && u235 / (u235 + u238) > tails_assay);
+  CompProperties props = CompProps(mat);
+  return (props.u238_atom_frac > 0 && props.assay > tails_assay);
 }
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-  double CascadeEnrich::FeedAssay() {
-  using cyclus::Material;
-
+double CascadeEnrich::FeedAssay() {
   if (inventory.empty()) {
     return 0;
   }
-  double pop_qty = inventory.quantity();
-  cyclus::Material::Ptr fission_matl =
-      inventory.Pop(pop_qty, cyclus::eps_rsrc());
-  inventory.Push(fission_matl);
-  return cyclus::toolkit::UraniumAssay(fission_matl);
+  SyncFeedTally_();
+  return feed_tally_.Assay();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void CascadeEnrich::SyncFeedTally_() {
+  if (cyclus::AlmostEq(feed_tally_.quantity(), inventory.quantity())) {
+    return;
+  }
+  cyclus::toolkit::MatVec mats = inventory.PopN(inventory.count());
+  inventory.Push(mats);
+  feed_tally_.Clear();
+  for (int i = 0; i < mats.size(); i++) {
+    feed_tally_.Add(mats[i]);
+  }
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
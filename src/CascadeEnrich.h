@@ -1,9 +1,12 @@
 #ifndef MBMORE_SRC_CASCADE_ENRICH_H_
 #define MBMORE_SRC_CASCADE_ENRICH_H_
 
+#include <map>
 #include <string>
 
 #include "cyclus.h"
+#include "enrich_converters.h"
+#include "enrich_functions.h"
 #include "sim_init.h"
 
 /*
@@ -37,78 +40,6 @@ B) Change cascade feed assay
 */
 namespace mbmore {
 
-/// @class SWUConverter
-///
-/// @brief The SWUConverter is a simple Converter class for material to
-/// determine the amount of SWU required for their proposed enrichment
-class SWUConverter : public cyclus::Converter<cyclus::Material> {
- public:
-  SWUConverter(double feed_commod, double tails)
-      : feed_(feed_commod), tails_(tails) {}
-  virtual ~SWUConverter() {}
-
-  /// @brief provides a conversion for the SWU required
-  virtual double convert(
-      cyclus::Material::Ptr m, cyclus::Arc const* a = NULL,
-      cyclus::ExchangeTranslationContext<cyclus::Material> const* ctx =
-          NULL) const {
-    cyclus::toolkit::Assays assays(feed_, cyclus::toolkit::UraniumAssay(m),
-                                   tails_);
-    return cyclus::toolkit::SwuRequired(m->quantity(), assays);
-  }
-
-  /// @returns true if Converter is a SWUConverter and feed and tails equal
-  virtual bool operator==(Converter& other) const {
-    SWUConverter* cast = dynamic_cast<SWUConverter*>(&other);
-    return cast != NULL && feed_ == cast->feed_ && tails_ == cast->tails_;
-  }
-
- private:
-  double feed_, tails_;
-};
-
-
-/// @class NatUConverter
-///
-/// @brief The NatUConverter is a simple Converter class for material to
-/// determine the amount of natural uranium required for their proposed
-/// enrichment
-class NatUConverter : public cyclus::Converter<cyclus::Material> {
- public:
-  NatUConverter(double feed_commod, double tails)
-      : feed_(feed_commod), tails_(tails) {}
-  virtual ~NatUConverter() {}
-
-  //  virtual std::string version() { return CYCAMORE_VERSION; }
-
-  /// @brief provides a conversion for the amount of natural Uranium required
-  virtual double convert(
-      cyclus::Material::Ptr m, cyclus::Arc const* a = NULL,
-      cyclus::ExchangeTranslationContext<cyclus::Material> const* ctx =
-          NULL) const {
-    cyclus::toolkit::Assays assays(feed_, cyclus::toolkit::UraniumAssay(m),
-                                   tails_);
-    cyclus::toolkit::MatQuery mq(m);
-    std::set<cyclus::Nuc> nucs;
-    nucs.insert(922350000);
-    nucs.insert(922380000);
-
-    double natu_frac = mq.mass_frac(nucs);
-    double natu_req = cyclus::toolkit::FeedQty(m->quantity(), assays);
-    return natu_req / natu_frac;
-  }
-
-  /// @returns true if Converter is a NatUConverter and feed and tails equal
-  virtual bool operator==(Converter& other) const {
-    NatUConverter* cast = dynamic_cast<NatUConverter*>(&other);
-    return cast != NULL && feed_ == cast->feed_ && tails_ == cast->tails_;
-  }
-
- private:
-  double feed_, tails_;
-};
-
-
 class CascadeEnrich : public cyclus::Facility {
 #pragma cyclus note { \
   "niche": "enrichment facility", \
@@ -221,10 +152,22 @@ class CascadeEnrich : public cyclus::Facility {
     return tails;
   }
 
+  ///  @brief assays and capacity the facility runs at for a feed assay
+  struct OperatingPoint {
+    double max_product;  // highest product assay that can be offered
+    double tails_assay;
+    double efficiency;   // fraction of the SWU capacity delivered as SWU
+    double max_feed;     // feed the stages can take (kg/month)
+  };
+
  private:
   ///  @brief calculates the feed assay based on the unenriched inventory
   double FeedAssay();
 
+  ///  @brief rebuilds feed_tally_ from the inventory if they are out of
+  ///  step (e.g. after a restart, when only the inventory is restored)
+  void SyncFeedTally_();
+
 
   ///   @brief adds a material into the natural uranium inventory
   ///   @throws if the material is not the same composition as the feed_recipe
@@ -244,12 +187,31 @@ class CascadeEnrich : public cyclus::Facility {
 
   cyclus::Material::Ptr Enrich_(cyclus::Material::Ptr mat, double qty);
 
+  ///  @brief operating point for a feed assay: the design values (tails_assay,
+  ///  max_enrich, full efficiency) unless the feed is off the design point,
+  ///  in which case they are moved by the off-design stage table solution.
+  ///  Does not change the facility state.
+  OperatingPoint OperatingPoint_(double feed_assay);
+
+  ///  @brief true if the facility has a stage table and the feed assay
+  ///  differs from design_feed_assay by more than design_feed_tolerance
+  bool OffDesign_(double feed_assay) const;
+
+  ///  @brief off-design performance of the built cascade for a feed assay,
+  ///  cached by assay bucket and solved at the bucket's central assay (at
+  ///  most assay_bucket / 2 from the feed assay)
+  const CascadePerformance& Performance_(double feed_assay);
+
   ///  @brief records and enrichment with the cyclus::Recorder
   void RecordEnrichment_(double natural_u, double swu);
 
-  // Set to design_tails at beginning of simulation. Gets reset if
-  // facility is used off-design
-  double tails_assay;  
+  ///  @brief records the trades summarized since the last summary as one
+  ///  row of the EnrichmentsSummary table, then clears the summary
+  void RecordSummary_();
+
+  // Set to design_tails at beginning of simulation. Off-design tails are
+  // taken relative to it for each trade (see OperatingPoint_)
+  double tails_assay;
 
   // These state variables are constrained by the design input params at
   // the start of the simulation:
@@ -262,6 +224,21 @@ class CascadeEnrich : public cyclus::Facility {
   int n_enrich_stages;
   int n_strip_stages;
 
+  // Stage by stage layout of the design cascade, built once in Build and
+  // used for off-design assays. Empty if the facility was not built.
+  StageTable stage_table;
+
+  // Off-design solutions for the stage table, keyed by feed assay bucket.
+  // They only depend on the fixed stage table so stay valid for the run.
+  std::map<int, CascadePerformance> performance_cache_;
+  const double assay_bucket = 1e-6;
+
+  // Feed assays within this fraction of design_feed_assay run at the design
+  // point. Wide enough that a natural uranium recipe matches the default
+  // design feed whether it is given in weight or atom fractions (these
+  // differ by about 1.3%).
+  const double design_feed_tolerance = 0.02;
+
   // Set by maximum allowable centrifuges
   double max_feed_inventory;
   double swu_capacity;
@@ -295,9 +272,8 @@ class CascadeEnrich : public cyclus::Facility {
 #pragma cyclus var {					      \
     "default": 0, "tooltip": "design feed flow (kg/mon)", \
     "uilabel": "Design Feed Flow", \
-    "doc": "Target amount of feed material to be processed by the" \
-    " facility (kg/mon). Either this or max_centrifuges is used to constrain" \
-    " the cascade design" }
+    "doc": "Not used: the cascade is sized from max_centrifuges alone." \
+    " Accepted so that existing input files still load (kg/mon)" }
   double design_feed_flow;
 
   #pragma cyclus var { \
@@ -401,6 +377,38 @@ class CascadeEnrich : public cyclus::Facility {
     "uilabel" : "Tails Commodity", "uitype" : "outcommodity" }
   std::string tails_commod;
 
+  #pragma cyclus var { \
+    "default" : 0, "tooltip" : "tails merging interval (timesteps)", \
+    "uilabel" : "Tails Merging Interval", \
+    "doc" : "merge tails lots of similar assay every this many timesteps " \
+            "(0 to only merge on tails_max_lots)" }
+  int tails_merge_interval;
+
+  #pragma cyclus var { \
+    "default" : 0, "tooltip" : "maximum number of tails lots", \
+    "uilabel" : "Maximum Tails Lots", \
+    "doc" : "merge tails lots of similar assay whenever the tails buffer " \
+            "holds more than this many lots (0 to only merge on " \
+            "tails_merge_interval)" }
+  int tails_max_lots;
+
+  #pragma cyclus var { \
+    "default" : 1e-4, "tooltip" : "assay bin width for merging tails", \
+    "uilabel" : "Tails Merging Assay Bin", \
+    "doc" : "tails lots are merged when their U235 assays fall in the same " \
+            "bin of this width" }
+  double tails_bin_width;
+
+  #pragma cyclus var { \
+    "default" : 0, "tooltip" : "enrichment recording interval (timesteps)", \
+    "uilabel" : "Enrichment Recording Interval", \
+    "doc" : "0 records every trade in the Enrichments table. N > 0 instead " \
+            "records one row per N timesteps in the EnrichmentsSummary table, " \
+            "with the number of trades and the sum, minimum and maximum of " \
+            "their natural uranium and SWU. Trades since the last summary " \
+            "row are not saved, so they are lost on a restart" }
+  int record_interval;
+
   double current_swu_capacity;
 
 #pragma cyclus var {}
@@ -411,11 +419,19 @@ class CascadeEnrich : public cyclus::Facility {
   double intra_timestep_swu_;
   double intra_timestep_feed_;
 
+  // trades not yet recorded when record_interval > 0 (not a state
+  // variable, so lost on restart)
+  TradeSummary trade_summary_;
+
 // END LEGACY
 
 #pragma cyclus var { 'capacity' : 'max_feed_inventory' }
   cyclus::toolkit::ResBuf<cyclus::Material> inventory;  // natural u
 
+  // U235/U238 content of the inventory, kept up to date on every push and
+  // pop so the feed assay is a constant time read
+  UraniumTally feed_tally_;
+
   friend class CascadeEnrichTest;
   // ---
 };
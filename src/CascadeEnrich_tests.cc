@@ -51,6 +51,7 @@ Composition::Ptr c_heu() {
   m[922380000] = 0.80;
   return Composition::CreateFromMass(m);
 };
+double AbundanceRatio(double assay) { return assay / (1 - assay); }
 }
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 TEST_F(CascadeEnrichTest, RequestQty) {
@@ -421,6 +422,7 @@ void CascadeEnrichTest::InitParameters() {
   ctx->AddRecipe(feed_recipe, recipe);
 
   tails_assay = 0.002;
+  max_enrich = 0.9;
   swu_capacity = 100;  //**
   inv_size = 5;
 
@@ -446,6 +448,15 @@ cyclus::Material::Ptr CascadeEnrichTest::GetMat(double qty) {
                                            tc_.get()->GetRecipe(feed_recipe));
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+cyclus::Material::Ptr CascadeEnrichTest::GetReqMat(double qty, double enr) {
+  cyclus::CompMap v;
+  v[922350000] = enr;
+  v[922380000] = 1 - enr;
+  return cyclus::Material::CreateUntracked(
+      qty, cyclus::Composition::CreateFromAtom(v));
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void CascadeEnrichTest::DoAddMat(cyclus::Material::Ptr mat) {
   src_facility->AddMat_(mat);
@@ -467,6 +478,64 @@ cyclus::Material::Ptr CascadeEnrichTest::DoEnrich(cyclus::Material::Ptr mat,
   return src_facility->Enrich_(mat, qty);
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+StageTable CascadeEnrichTest::SetStageTable(double design_feed) {
+  double machine_feed = src_facility->Mg2kgPerSec(15);
+  double cut = src_facility->cut;
+  double delU = CalcDelU(485.0, 0.5, 0.15, machine_feed, 320.0, cut,
+                         src_facility->eff, src_facility->M, src_facility->dM,
+                         src_facility->x, src_facility->flow_internal);
+  double alpha = AlphaBySwu(delU, machine_feed, cut, src_facility->M);
+  double design_product = 0.05;
+  std::pair<int, int> n_stages =
+      FindNStages(alpha, design_feed, design_product, tails_assay);
+  CascadeSize size = SizeCascade(alpha, delU, cut, 1000, n_stages);
+
+  src_facility->design_feed_assay = design_feed;
+  src_facility->design_product_assay = design_product;
+  src_facility->stage_table = BuildStageTable(design_feed, alpha, delU, cut,
+                                              n_stages, size.feed_flow);
+  return src_facility->stage_table;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+StageTable CascadeEnrichTest::DoBuild(int max_centrifuges) {
+  src_facility->centrifuge_velocity = 485.0;
+  src_facility->height = 0.5;
+  src_facility->diameter = 0.15;
+  src_facility->machine_feed = 15.0;
+  src_facility->temp = 320.0;
+  src_facility->design_feed_assay = 0.0071;
+  src_facility->design_product_assay = 0.035;
+  src_facility->design_tails_assay = 0.003;
+  src_facility->max_centrifuges = max_centrifuges;
+  src_facility->initial_feed = 0;
+  src_facility->Build(NULL);
+  return src_facility->stage_table;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+double CascadeEnrichTest::DoFeedAssay() { return src_facility->FeedAssay(); }
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+CascadeEnrich::OperatingPoint CascadeEnrichTest::DoOperatingPoint(
+    double feed_assay) {
+  return src_facility->OperatingPoint_(feed_assay);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+double CascadeEnrichTest::CurrentSwu() {
+  return src_facility->current_swu_capacity;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+double CascadeEnrichTest::InventoryQty() {
+  return src_facility->inventory.quantity();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+double CascadeEnrichTest::TailsAssay() { return src_facility->tails_assay; }
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 TEST_F(CascadeEnrichTest, Request) {
   // Tests that quantity in material request is accurate
@@ -674,6 +743,211 @@ TEST_F(CascadeEnrichTest, Response) {
   EXPECT_EQ(responses.size(), 2);
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(CascadeEnrichTest, DesignOperation) {
+  // At the design feed assay the built stages do not change the design
+  // tails, the max_enrich bid cap or the SWU needed
+  using cyclus::BidPortfolio;
+  using cyclus::Material;
+  using cyclus::Request;
+  using cyclus::toolkit::Assays;
+  using cyclus::toolkit::FeedQty;
+  using cyclus::toolkit::SwuRequired;
+
+  DoAddMat(GetMat(inv_size));
+  double feed = DoFeedAssay();
+  StageTable stages = SetStageTable(feed);
+
+  // the stage table is built from whole stages so its ends are not the
+  // design assays
+  ASSERT_GT(stages.ProductAssay(), 0.05);
+  ASSERT_LT(stages.TailsAssay(), tails_assay);
+
+  cyclus::CommodMap<Material>::type out_requests;
+  out_requests[product_commod].push_back(Request<Material>::Create(
+      GetReqMat(1.0, 0.2), trader, product_commod));
+  std::set<BidPortfolio<Material>::Ptr> ports =
+      src_facility->GetMatlBids(out_requests);
+  ASSERT_EQ(ports.size(), 1);
+  EXPECT_EQ((*ports.begin())->bids().size(), 1);
+
+  double qty = 0.5;
+  Material::Ptr target = GetReqMat(qty, 0.03);
+  Assays assays(feed, CompProps(target).assay, tails_assay);
+  double swu_before = CurrentSwu();
+  double inv_before = InventoryQty();
+  DoEnrich(target, qty);
+
+  EXPECT_DOUBLE_EQ(TailsAssay(), tails_assay);
+  EXPECT_NEAR(swu_before - CurrentSwu(), SwuRequired(qty, assays), 1e-9);
+  EXPECT_NEAR(inv_before - InventoryQty(), FeedQty(qty, assays), 1e-9);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(CascadeEnrichTest, OffDesignOperation) {
+  // Fed below its design feed assay the built cascade makes leaner product
+  // and tails and needs more SWU, without changing the facility's tails
+  using cyclus::BidPortfolio;
+  using cyclus::CapacityConstraint;
+  using cyclus::Material;
+  using cyclus::Request;
+  using cyclus::toolkit::Assays;
+  using cyclus::toolkit::FeedQty;
+  using cyclus::toolkit::SwuRequired;
+  using cyclus::toolkit::TailsQty;
+
+  DoAddMat(GetMat(inv_size));
+  double feed = DoFeedAssay();
+  SetStageTable(0.01);
+
+  CascadeEnrich::OperatingPoint op = DoOperatingPoint(feed);
+  EXPECT_LT(op.tails_assay, tails_assay);
+  EXPECT_GT(op.max_product, 0.03);
+  EXPECT_LT(op.max_product, 0.04);
+  EXPECT_GT(op.efficiency, 0);
+  EXPECT_LT(op.efficiency, 1);
+
+  // only the request the stages can reach gets a bid, and the SWU
+  // constraint is reduced by the efficiency
+  cyclus::CommodMap<Material>::type out_requests;
+  out_requests[product_commod].push_back(Request<Material>::Create(
+      GetReqMat(1.0, 0.03), trader, product_commod));
+  out_requests[product_commod].push_back(Request<Material>::Create(
+      GetReqMat(1.0, 0.04), trader, product_commod));
+  std::set<BidPortfolio<Material>::Ptr> ports =
+      src_facility->GetMatlBids(out_requests);
+  ASSERT_EQ(ports.size(), 1);
+  BidPortfolio<Material>::Ptr port = *ports.begin();
+  ASSERT_EQ(port->bids().size(), 1);
+  EXPECT_NEAR(CompProps((*port->bids().begin())->offer()).assay, 0.03, 1e-9);
+  bool swu_constraint = false;
+  std::set<CapacityConstraint<Material> >::const_iterator it;
+  for (it = port->constraints().begin(); it != port->constraints().end();
+       ++it) {
+    swu_constraint |= cyclus::AlmostEq(it->capacity(),
+                                       swu_capacity * op.efficiency);
+  }
+  EXPECT_TRUE(swu_constraint);
+  EXPECT_DOUBLE_EQ(TailsAssay(), tails_assay);
+
+  // SWU, feed and tails follow the off-design tails and efficiency
+  double qty = 0.5;
+  Material::Ptr target = GetReqMat(qty, 0.03);
+  Assays assays(feed, CompProps(target).assay, op.tails_assay);
+  double swu_before = CurrentSwu();
+  double inv_before = InventoryQty();
+  DoEnrich(target, qty);
+
+  EXPECT_DOUBLE_EQ(TailsAssay(), tails_assay);
+  EXPECT_NEAR(swu_before - CurrentSwu(),
+              SwuRequired(qty, assays) / op.efficiency, 1e-9);
+  EXPECT_NEAR(inv_before - InventoryQty(), FeedQty(qty, assays), 1e-9);
+  EXPECT_NEAR(src_facility->Tails().quantity(), TailsQty(qty, assays), 1e-9);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(CascadeEnrichTest, BuildStages) {
+  // Build lays out the same cascade that DesignCascade sizes for the
+  // available centrifuges
+  int max_centrifuges = 1000;
+  StageTable stages = DoBuild(max_centrifuges);
+  ASSERT_FALSE(stages.empty());
+
+  std::pair<int, int> n_stages =
+      FindNStages(stages.alpha, 0.0071, 0.035, 0.003);
+  std::pair<int, double> design =
+      DesignCascade(0, stages.alpha, stages.del_U, stages.cut,
+                    max_centrifuges, n_stages);
+  EXPECT_EQ(stages.size(), n_stages.first + n_stages.second);
+  EXPECT_EQ(stages.n_strip, n_stages.second);
+  EXPECT_EQ(stages.TotalMachines(), design.first);
+  EXPECT_LE(stages.TotalMachines(), max_centrifuges);
+  EXPECT_DOUBLE_EQ(stages.cascade_feed, design.second);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(CascadeEnrichTest, BuildNoCentrifuges) {
+  // Without centrifuges there are no stages to run off-design
+  EXPECT_TRUE(DoBuild(0).empty());
+  EXPECT_DOUBLE_EQ(src_facility->SwuCapacity(), 0);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(CascadeEnrichTest, NaturalFeedAtDesign) {
+  // Natural uranium given in weight fractions (natu1) or in atom fractions
+  // (the fixture recipe) runs at the default design point
+  using cyclus::BidPortfolio;
+  using cyclus::CapacityConstraint;
+  using cyclus::Material;
+  using cyclus::Request;
+
+  ASSERT_FALSE(DoBuild(1000).empty());
+  DoAddMat(Material::CreateUntracked(inv_size, cascadenrichtest::c_natu1()));
+  double feed = DoFeedAssay();
+  EXPECT_NEAR(feed, 0.00709, 1e-5);
+
+  double natural_feeds[] = {feed, feed_assay};
+  for (int i = 0; i < 2; i++) {
+    CascadeEnrich::OperatingPoint op = DoOperatingPoint(natural_feeds[i]);
+    EXPECT_DOUBLE_EQ(op.tails_assay, TailsAssay());
+    EXPECT_DOUBLE_EQ(op.max_product, max_enrich);
+    EXPECT_DOUBLE_EQ(op.efficiency, 1.0);
+  }
+
+  // the bid is only limited by the full SWU capacity and the inventory
+  cyclus::CommodMap<Material>::type out_requests;
+  out_requests[product_commod].push_back(Request<Material>::Create(
+      GetReqMat(1.0, 0.2), trader, product_commod));
+  std::set<BidPortfolio<Material>::Ptr> ports =
+      src_facility->GetMatlBids(out_requests);
+  ASSERT_EQ(ports.size(), 1);
+  BidPortfolio<Material>::Ptr port = *ports.begin();
+  EXPECT_EQ(port->bids().size(), 1);
+  ASSERT_EQ(port->constraints().size(), 2);
+  std::set<double> capacities;
+  std::set<CapacityConstraint<Material> >::const_iterator it;
+  for (it = port->constraints().begin(); it != port->constraints().end();
+       ++it) {
+    capacities.insert(it->capacity());
+  }
+  EXPECT_EQ(capacities.count(src_facility->SwuCapacity()), 1);
+  EXPECT_EQ(capacities.count(inv_size), 1);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(CascadeEnrichTest, OffDesignShiftBound) {
+  // Off the design point the operating tails and product differ from the
+  // direct stage table solution for the same feed only by the stage table's
+  // whole-stage offset from the design assays
+  StageTable stages = SetStageTable(0.01);
+  double product_offset =
+      cascadenrichtest::AbundanceRatio(0.05) /
+      cascadenrichtest::AbundanceRatio(stages.ProductAssay());
+  double tails_offset =
+      cascadenrichtest::AbundanceRatio(tails_assay) /
+      cascadenrichtest::AbundanceRatio(stages.TailsAssay());
+  ASSERT_GT(product_offset, 1 / stages.alpha);
+  ASSERT_LE(product_offset, 1);
+  ASSERT_GE(tails_offset, 1);
+  ASSERT_LT(tails_offset, stages.alpha);
+
+  double feeds[] = {0.005, 0.0072, 0.0085, 0.012, 0.015};
+  for (int i = 0; i < 5; i++) {
+    CascadeEnrich::OperatingPoint op = DoOperatingPoint(feeds[i]);
+    CascadePerformance direct =
+        SolveOffDesign(stages, feeds[i], stages.cascade_feed);
+    EXPECT_NEAR(cascadenrichtest::AbundanceRatio(op.max_product) /
+                    cascadenrichtest::AbundanceRatio(direct.product_assay),
+                product_offset, 1e-3)
+        << "feed " << feeds[i];
+    EXPECT_NEAR(cascadenrichtest::AbundanceRatio(op.tails_assay) /
+                    cascadenrichtest::AbundanceRatio(direct.tails_assay),
+                tails_offset, 1e-3)
+        << "feed " << feeds[i];
+    EXPECT_NEAR(op.efficiency, direct.efficiency, 1e-3) << "feed " << feeds[i];
+  }
+}
+
 }  // namespace cycamore
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -41,6 +41,19 @@ class CascadeEnrichTest : public ::testing::Test {
   cyclus::Material::Ptr DoBid(cyclus::Material::Ptr mat);
   cyclus::Material::Ptr DoOffer(cyclus::Material::Ptr mat);
   cyclus::Material::Ptr DoEnrich(cyclus::Material::Ptr mat, double qty);
+  /// @brief gives the facility the stage table of a 1000 machine cascade
+  /// designed for the given feed assay (product 0.05, tails tails_assay)
+  /// @return the stage table
+  StageTable SetStageTable(double design_feed);
+  /// @brief builds the facility with the default machine and design assays
+  /// (feed 0.0071, product 0.035, tails 0.003) and no initial feed
+  /// @return the facility's stage table
+  StageTable DoBuild(int max_centrifuges);
+  double DoFeedAssay();
+  CascadeEnrich::OperatingPoint DoOperatingPoint(double feed_assay);
+  double CurrentSwu();
+  double InventoryQty();
+  double TailsAssay();
   /// @param nreqs the total number of requests
   /// @param nvalid the number of requests that are valid
   boost::shared_ptr< cyclus::ExchangeContext<cyclus::Material> >
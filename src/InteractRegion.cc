@@ -1,5 +1,6 @@
 // Implements the Region class
 #include "InteractRegion.h"
+#include "StateInst.h"
 #include "behavior_functions.h"
 
 #include <iostream>
@@ -11,9 +12,44 @@ namespace mbmore {
 // Globally scoped list of columns for the database
   std::vector<std::string> InteractRegion::column_names;
 
+namespace {
+
+// Conflict scores by [relation][statusA][statusB], with relations ordered
+// ally, neutral, enemy and weapon statuses ordered 0 (not pursuing),
+// 2 (pursuing), 3 (acquired). Scores are symmetric in the two statuses.
+constexpr int kConflictScores[3][3][3] = {
+  // ally
+  {{2, 3, 1},
+   {3, 3, 3},
+   {1, 3, 1}},
+  // neutral
+  {{2, 4, 4},
+   {4, 4, 5},
+   {4, 5, 3}},
+  // enemy
+  {{6, 8, 6},
+   {8, 9, 10},
+   {6, 10, 5}},
+};
+
+inline int RelationIndex(int relation) {
+  return (relation == 1) ? 0 : ((relation == 0) ? 1 : 2);
+}
+
+// any status that is not 0, 2 or 3 is treated as never pursued
+inline int StatusIndex(int status) {
+  return (status == 2) ? 1 : ((status == 3) ? 2 : 0);
+}
+
+}  // namespace
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 InteractRegion::InteractRegion(cyclus::Context* ctx)
-  : cyclus::Region(ctx) {
+  : cyclus::Region(ctx),
+    eval_time_(-1),
+    eval_version_(-1),
+    sched_time_(-1),
+    relations_version_(0) {
     //  kind_ = "InteractRegion";
   cyclus::Warn<cyclus::EXPERIMENTAL_WARNING>("the InteractRegion agent is experimental.");
 
@@ -24,6 +60,16 @@ InteractRegion::InteractRegion(cyclus::Context* ctx)
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   void InteractRegion::Build(cyclus::Agent* parent) {
     cyclus::Agent::Build(parent);
+
+    std::map<std::string, std::pair<std::string, std::vector<double> > >::
+      const_iterator it;
+    for (it = likely_rescale.begin(); it != likely_rescale.end(); ++it) {
+      likely_curves_[it->first] =
+	TimeCurve(it->second.first, it->second.second);
+    }
+
+    // weapon statuses already in the graph are kept
+    conflict_graph_.Build(p_conflict_map);
 }
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 std::map<std::string, double>
@@ -31,16 +77,40 @@ std::map<std::string, double>
     return wts;
 }
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-int InteractRegion::GetNStates() {
-  int n_states = 0;
-  for (std::set<Agent*>::const_iterator inst = children().begin();
-       inst != children().end();
-       inst++) {
-    if ((*inst)->spec() == ":mbmore:StateInst") {
-      n_states++; 
-    }
+void InteractRegion::BuildNotify(cyclus::Agent* m) {
+  StateInst* state = dynamic_cast<StateInst*>(m);
+  if (state != NULL) {
+    RegisterState(state);
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void InteractRegion::DecomNotify(cyclus::Agent* m) {
+  StateInst* state = dynamic_cast<StateInst*>(m);
+  if (state != NULL) {
+    UnregisterState(state);
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void InteractRegion::RegisterState(StateInst* state) {
+  if (state_index_.count(state->id()) == 0) {
+    state_index_[state->id()] = states_.size();
+    states_.push_back(state);
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void InteractRegion::UnregisterState(StateInst* state) {
+  std::map<int, int>::iterator it = state_index_.find(state->id());
+  if (it == state_index_.end()) {
+    return;
+  }
+  states_.erase(states_.begin() + it->second);
+  state_index_.erase(it);
+  for (int i = 0; i < states_.size(); i++) {
+    state_index_[states_[i]->id()] = i;
   }
-  return n_states;
 }
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void InteractRegion::Tick() {
@@ -95,6 +165,12 @@ void InteractRegion::Tick() {
   }
 }
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void InteractRegion::Tock() {
+  if (sched_time_ != context()->time()) {
+    ScheduleDecisions_();
+  }
+}
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 // Determines which factors are defined for this sim
 std::map<std::string, bool>
   InteractRegion::DefinedFactors(std::string eqn_type) {
@@ -124,22 +200,29 @@ std::vector<std::string>& InteractRegion::GetMainFactors() {
 // (where the current value of the equation is normalized to be between 0-1)
 double InteractRegion::GetLikely(std::string phase, double eqn_val) {
 
-  double hist_duration = 75; // historical data covers 70 years
+  std::map<std::string, TimeCurve>::const_iterator curve_it =
+    likely_curves_.find(phase);
+  if (curve_it == likely_curves_.end()) {
+    throw "Function choices are constant, linear, step, power";
+  }
+  return PhaseLikely_(curve_it->second, phase == "Pursuit", eqn_val);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+double InteractRegion::PhaseLikely_(const TimeCurve& curve, bool pursuit,
+				    double eqn_val) {
 
-  std::pair<std::string, std::vector<double> > likely_pair =
-    likely_rescale[phase];
-  std::string function = likely_pair.first;
-  std::vector<double> constants = likely_pair.second;
+  double hist_duration = 75; // historical data covers 70 years
 
   double phase_likely;
-  if (phase == "Pursuit"){
+  if (pursuit){
     double integ_likely;
     // historical data defines the likelihood integrated over 70yrs
-    if ((function == "Power") || (function == "power")){
-      integ_likely = CalcYVal(function, constants, eqn_val/10.0);
+    if (curve.type() == TimeCurve::POWER){
+      integ_likely = curve.Evaluate(eqn_val/10.0);
     }
     else {
-      integ_likely = CalcYVal(function, constants, eqn_val);
+      integ_likely = curve.Evaluate(eqn_val);
     }
     phase_likely = ProbPerTime(integ_likely, hist_duration);
   }
@@ -148,7 +231,7 @@ double InteractRegion::GetLikely(std::string phase, double eqn_val) {
     // then convert to a likelihood per timestep 1/(N_years)
     // TODO: CHANGE HARDCODING TO CHECK FOR ARBITRARY TIMESTEP DURATION
     //       (currently assumes timestep is one year)
-    double avg_time = CalcYVal(function, constants, eqn_val);
+    double avg_time = curve.Evaluate(eqn_val);
     phase_likely = 1.0/avg_time;
   }
 
@@ -161,6 +244,161 @@ double InteractRegion::GetLikely(std::string phase, double eqn_val) {
   return phase_likely;
   
 }
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// The weights and factor curves only change when states enter or leave, so
+// they are gathered into the table once per list of states.
+void InteractRegion::BuildStateTable_(const std::vector<StateInst*>& states) {
+  int n_states = states.size();
+  int n_factors = column_names.size();
+
+  eval_states_ = states;
+  eval_rows_.clear();
+  for (int s = 0; s < n_states; s++) {
+    eval_rows_[states[s]->id()] = s;
+  }
+
+  factor_defined_.assign(n_factors, false);
+  factor_wts_.assign(n_factors, 0.0);
+  eval_curves_.assign(n_factors * n_states, TimeCurve());
+  for (int f = 0; f < n_factors; f++) {
+    std::map<std::string, double>::const_iterator wt_it =
+      wts.find(column_names[f]);
+    if (wt_it == wts.end()) {   // factor isn't defined in input file
+      continue;
+    }
+    factor_defined_[f] = true;
+    factor_wts_[f] = wt_it->second;
+    // Conflict is scored from the relations between states, not a curve
+    if (column_names[f] != "Conflict") {
+      for (int s = 0; s < n_states; s++) {
+	eval_curves_[f * n_states + s] =
+	  states[s]->FactorCurve(column_names[f]);
+      }
+    }
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Each factor is evaluated for all states before the next factor, and the
+// rows are independent of each other.
+void InteractRegion::EvaluateStates() {
+  if ((states_ != eval_states_) ||
+      (factor_defined_.size() != column_names.size())) {
+    BuildStateTable_(states_);
+  }
+
+  int n_states = eval_states_.size();
+  int n_factors = column_names.size();
+  double time = context()->time();
+
+  eval_factors_.assign(n_factors * n_states, 0.0);
+  eval_eqn_.assign(n_states, 0.0);
+  for (int f = 0; f < n_factors; f++) {
+    if (!factor_defined_[f]) {
+      continue;
+    }
+    double* vals = &eval_factors_[f * n_states];
+    if (column_names[f] == "Conflict") {
+      // Determine each State's conflict score for this timestep
+      if (n_states > 1) {
+	for (int s = 0; s < n_states; s++) {
+	  vals[s] = GetConflictScore("Pursuit", eval_states_[s]->prototype());
+	}
+      }
+    }
+    else {
+      const TimeCurve* curves = &eval_curves_[f * n_states];
+      for (int s = 0; s < n_states; s++) {
+	vals[s] = curves[s].Evaluate(time);
+      }
+    }
+    double wt = factor_wts_[f];
+    for (int s = 0; s < n_states; s++) {
+      eval_eqn_[s] += vals[s] * wt;
+    }
+  }
+
+  // Convert each equation to the likelihood for the state's current phase:
+  // Pursuit if not pursuing (0), Acquire if pursuing (2)
+  std::map<std::string, TimeCurve>::const_iterator pursuit_it =
+    likely_curves_.find("Pursuit");
+  std::map<std::string, TimeCurve>::const_iterator acquire_it =
+    likely_curves_.find("Acquire");
+  eval_phase_.assign(n_states, 0);
+  eval_likely_.assign(n_states, 0.0);
+  for (int s = 0; s < n_states; s++) {
+    int status = eval_states_[s]->WeaponStatus();
+    if (status == 0) {
+      eval_phase_[s] = 1;
+      eval_likely_[s] = (pursuit_it == likely_curves_.end()) ?
+	GetLikely("Pursuit", eval_eqn_[s]) :
+	PhaseLikely_(pursuit_it->second, true, eval_eqn_[s]);
+    }
+    else if (status == 2) {
+      eval_phase_[s] = 2;
+      eval_likely_[s] = (acquire_it == likely_curves_.end()) ?
+	GetLikely("Acquire", eval_eqn_[s]) :
+	PhaseLikely_(acquire_it->second, false, eval_eqn_[s]);
+    }
+  }
+  eval_time_ = context()->time();
+  eval_version_ = relations_version_;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+int InteractRegion::WeaponEqnRow(const StateInst* state) {
+  if (eval_time_ != context()->time()) {
+    EvaluateStates();
+  }
+  std::map<int, int>::const_iterator row_it = eval_rows_.find(state->id());
+  if (row_it == eval_rows_.end()) {
+    std::stringstream ss;
+    ss << "State " << state->prototype()
+       << " is not a StateInst of this InteractRegion";
+    throw cyclus::ValueError(ss.str());
+  }
+  return row_it->second;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// States are asked before any of them acts this timestep, so the schedule
+// does not depend on the order in which the states run.
+void InteractRegion::ScheduleDecisions_() {
+  int time = context()->time();
+  bool any_due = false;
+  sched_due_.assign(states_.size(), false);
+  for (int i = 0; i < states_.size(); i++) {
+    sched_due_[i] = states_[i]->DecisionDue(time, relations_version_);
+    any_due = any_due || sched_due_[i];
+  }
+  sched_time_ = time;
+  if (any_due && (eval_time_ != time)) {
+    EvaluateStates();
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool InteractRegion::DecisionDue(const StateInst* state) {
+  if (sched_time_ != context()->time()) {
+    ScheduleDecisions_();
+  }
+  std::map<int, int>::const_iterator it = state_index_.find(state->id());
+  if ((it == state_index_.end()) || (it->second >= sched_due_.size())) {
+    // not registered when the timestep was scheduled
+    return true;
+  }
+  return sched_due_[it->second];
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+double InteractRegion::WeaponEqnLikely(int row, const std::string& phase) {
+  int phase_id = (phase == "Pursuit") ? 1 : ((phase == "Acquire") ? 2 : -1);
+  if (eval_phase_[row] == phase_id) {
+    return eval_likely_[row];
+  }
+  return GetLikely(phase, eval_eqn_[row]);
+}
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 // Determine the Conflict or Military Isolation actor for the state at each
 // timestep. Begin with the map of relations to all other states, sum these
@@ -172,34 +410,19 @@ double InteractRegion::GetConflictScore(std::string eqn_type,
   int gross_score = 0;
   int n_entries = 0;
 
-  std::map<std::pair<std::string, std::string>,int>::iterator map_it;
-  for (map_it = p_conflict_map.begin();
-       map_it != p_conflict_map.end(); ++map_it){
-    std::string curr_state = map_it->first.first;
-    if (curr_state == prototype){
-      n_entries+=1;
-      std::string other_state = map_it->first.second;
+  int id = conflict_graph_.FindState(prototype);
+  if (id >= 0) {
+    n_entries = conflict_graph_.degree(id);
+    const int* others = conflict_graph_.others(id);
+    const int* relations = conflict_graph_.relations(id);
 
+    // what is each state's NW status?
+    int my_weapon_status = conflict_graph_.status(id);
+    for (int i = 0; i < n_entries; i++) {
       // allies, neutral, or enemies
-      int this_relation = map_it->second;
-      
-      // what is each state's NW status?
-      int my_weapon_status = sim_weapon_status[prototype];
-      int other_weapon_status = sim_weapon_status[other_state];
-      
-      std::string relation_string;
-      // order smallest number first (0_2 instead of 2_0)
-      if (my_weapon_status > other_weapon_status){
-	relation_string = BuildRelationString(other_weapon_status,
-					      my_weapon_status,
-					      this_relation);
-      }
-      else {
-	relation_string = BuildRelationString(my_weapon_status,
-					      other_weapon_status,
-					      this_relation);
-      }
-      gross_score += score_matrix[relation_string];
+      gross_score += ConflictScore(my_weapon_status,
+				   conflict_graph_.status(others[i]),
+				   relations[i]);
     }
   }
   if (n_entries == 0){
@@ -216,6 +439,12 @@ double InteractRegion::GetConflictScore(std::string eqn_type,
   return avg_score;
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+int InteractRegion::ConflictScore(int statusA, int statusB, int relation) {
+  return kConflictScores[RelationIndex(relation)][StatusIndex(statusA)]
+    [StatusIndex(statusB)];
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 // Make a string that contains the weapons status of states A and state B, as
 // well as their relationship as statusA_statusB_relationship
@@ -265,10 +494,13 @@ void InteractRegion::ChangeConflictReln(std::string eqn_type,
 
   p_conflict_map[std::pair<std::string, std::string>
 		 (this_state, other_state)] = new_val;
+  conflict_graph_.SetRelation(this_state, other_state, new_val);
+  relations_version_++;
   RecordConflictReln(eqn_type, this_state, other_state, new_val);
   if (symmetric == 1){
     p_conflict_map[std::pair<std::string, std::string>
 		   (other_state, this_state)] = new_val;
+    conflict_graph_.SetRelation(other_state, this_state, new_val);
     RecordConflictReln(eqn_type, other_state, this_state, new_val);
   }
 }
@@ -280,13 +512,10 @@ void InteractRegion::ChangeConflictReln(std::string eqn_type,
 void InteractRegion::UpdateWeaponStatus(std::string proto,
 					int new_weapon_status){
 
-  // add new key value pair. If key already exists then just update value
-  std::pair<std::map<std::string, int>::iterator, bool> ret;
-  ret = sim_weapon_status.insert(std::pair<std::string, int>
-				 (proto, new_weapon_status));
-  if (ret.second ==false){
-    sim_weapon_status[proto] = new_weapon_status;
-  }
+  // adds the state to the graph if it has no relations yet
+  conflict_graph_.set_status(conflict_graph_.AddState(proto),
+			     new_weapon_status);
+  relations_version_++;
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -306,31 +535,19 @@ void InteractRegion::RecordConflictReln(std::string eqn_type,
   d->Record();
 }
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-// Build Score Matrix
+// Build Score Matrix (string keyed copy of the ConflictScore table)
   void InteractRegion::BuildScoreMatrix(){
-    score_matrix.insert(std::pair<std::string, int>("ally_0_0", 2));
-    score_matrix.insert(std::pair<std::string, int>("neut_0_0", 2));
-    score_matrix.insert(std::pair<std::string, int>("enemy_0_0", 6));
-    
-    score_matrix.insert(std::pair<std::string, int>("ally_0_2", 3));
-    score_matrix.insert(std::pair<std::string, int>("neut_0_2", 4));
-    score_matrix.insert(std::pair<std::string, int>("enemy_0_2", 8));
-    
-    score_matrix.insert(std::pair<std::string, int>("ally_0_3", 1));
-    score_matrix.insert(std::pair<std::string, int>("neut_0_3", 4));
-    score_matrix.insert(std::pair<std::string, int>("enemy_0_3", 6));
-    
-    score_matrix.insert(std::pair<std::string, int>("ally_2_2", 3));
-    score_matrix.insert(std::pair<std::string, int>("neut_2_2", 4));
-    score_matrix.insert(std::pair<std::string, int>("enemy_2_2", 9));
-    
-    score_matrix.insert(std::pair<std::string, int>("ally_2_3", 3));
-    score_matrix.insert(std::pair<std::string, int>("neut_2_3", 5));
-    score_matrix.insert(std::pair<std::string, int>("enemy_2_3", 10));
-    
-    score_matrix.insert(std::pair<std::string, int>("ally_3_3", 1));
-    score_matrix.insert(std::pair<std::string, int>("neut_3_3", 3));
-    score_matrix.insert(std::pair<std::string, int>("enemy_3_3", 5));
+    int relations[] = {1, 0, -1};
+    int statuses[] = {0, 2, 3};
+    for (int r = 0; r < 3; r++) {
+      for (int a = 0; a < 3; a++) {
+	for (int b = a; b < 3; b++) {
+	  score_matrix.insert(std::pair<std::string, int>(
+	      BuildRelationString(statuses[a], statuses[b], relations[r]),
+	      ConflictScore(statuses[a], statuses[b], relations[r])));
+	}
+      }
+    }
   }
   
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -1,10 +1,14 @@
 #ifndef MBMORE_SRC_INTERACT_REGION_H_
 #define MBMORE_SRC_INTERACT_REGION_H_
 
+#include "behavior_functions.h"
+#include "conflict_graph.h"
 #include "cyclus.h"
 
 namespace mbmore {
 
+class StateInst;
+
 /// @class Region
 ///
 /// The Region class is the abstract class/interface used by all
@@ -31,7 +35,9 @@ class InteractRegion
 
   virtual void Tick();
 
-  virtual void Tock() {}
+  // decides which states make a weapon decision this timestep and
+  // evaluates their equations (if no state has requested them yet)
+  virtual void Tock();
 
   // perform actions required when entering the simulation
   virtual void Build(cyclus::Agent* parent);
@@ -39,18 +45,75 @@ class InteractRegion
   /// enter the simulation and register any children present
   //  virtual void EnterNotify();
 
+  /// register a new StateInst child
+  virtual void BuildNotify(cyclus::Agent* m);
+
+  /// unregister a StateInst child
+  virtual void DecomNotify(cyclus::Agent* m);
+
+  // Adds state to the registry of states in this region (no effect if it is
+  // already registered). States also register themselves when they enter
+  // the simulation.
+  void RegisterState(StateInst* state);
+
+  // Removes state from the registry (no effect if it is not registered)
+  void UnregisterState(StateInst* state);
+
+  // The registered states, in order of registration
+  const std::vector<StateInst*>& GetStates() const { return states_; }
+
   // shares the pursuit and acquisition equation weighting information
   // with the child institutions
   std::map<std::string, double> GetWeights(std::string eqn_type);
 
   // Determines # of states in the simulation. If only one state then
   // Interactive Factors (such as conflict) are not calculated.
-  int GetNStates();
+  int GetNStates() const { return states_.size(); }
   
   // Uses the pursuit or acquire likelihood conversion equation to determine the
   // likeliness of pursuit and acquire on a 0-1 scale for the requested timestep
   double GetLikely(std::string phase, double eqn_val);
 
+  // Evaluates the factors, pursuit equation and likelihood (for the phase
+  // of its weapon status) of every child StateInst for the current timestep
+  // in one pass over a table of all states. Done once per timestep, on the
+  // first request, so every state sees the relations and weapon statuses
+  // from the start of the timestep.
+  void EvaluateStates();
+
+  // Row of state in this timestep's evaluation (evaluating all states first
+  // if needed)
+  int WeaponEqnRow(const StateInst* state);
+
+  // True if state makes a weapon decision this timestep. Which states do
+  // is settled once per timestep, on the first request, from the states'
+  // own schedules (see StateInst::DecisionDue), and all states are
+  // evaluated then if any of them do.
+  bool DecisionDue(const StateInst* state);
+
+  // Counts the changes to conflict relations and weapon statuses, which
+  // change conflict scores
+  long RelationsVersion() const { return relations_version_; }
+
+  // RelationsVersion when this timestep's evaluation was made
+  long EvalVersion() const { return eval_version_; }
+
+  // True if main factor f (index into GetMainFactors) is weighted in this
+  // sim
+  bool FactorDefined(int f) const { return factor_defined_[f]; }
+
+  // Value of main factor f for the state in row (0 if not defined)
+  double WeaponEqnFactor(int row, int f) const {
+    return eval_factors_[f * eval_states_.size() + row];
+  }
+
+  // Weighted sum of the factors of the state in row
+  double WeaponEqnVal(int row) const { return eval_eqn_[row]; }
+
+  // Likelihood of the phase (Pursuit or Acquire) for the state in row,
+  // precomputed for the phase of its weapon status
+  double WeaponEqnLikely(int row, const std::string& phase);
+
 
   // Determines which factors are defined for this sim
   std::map<std::string, bool> DefinedFactors(std::string eqn_type);
@@ -63,13 +126,18 @@ class InteractRegion
   std::vector<std::string>& GetMainFactors();
 
   // Tracks weapons status of each state (0 = not pursuing, 2 = pursuing,
-  // 3 = acquired) by updating the sim_weapon_status map
+  // 3 = acquired), held by state in the conflict graph
   virtual void UpdateWeaponStatus(std::string proto, int new_weapon_status);
 
   // Determines Conflict score for each state based on its net
   // relationships with other states and both states' weapon status
   double GetConflictScore(std::string eqn_type, std::string prototype);
 
+  // Conflict score for a pair of states given their weapon statuses and
+  // their relationship (+1 ally, 0 neutral, otherwise enemy), read from a
+  // fixed table. Statuses other than 0, 2 and 3 count as 0.
+  static int ConflictScore(int statusA, int statusB, int relation);
+
   // Builds a string to use as key for map that defines the conflict score
   // for a pair states based on their ally/neutral/enemy relationship
   std::string BuildRelationString(int statusA, int statusB, int relation);
@@ -124,6 +192,29 @@ bool symmetric;
   std::map<std::string, std::pair<std::string, std::vector<double> > >
     likely_rescale ;
 
+  // likely_rescale functions, parsed in Build
+  std::map<std::string, TimeCurve> likely_curves_;
+
+  // likelihood of a phase for the value of its equation
+  double PhaseLikely_(const TimeCurve& curve, bool pursuit, double eqn_val);
+
+  // Sets up the evaluation table for a new list of states
+  void BuildStateTable_(const std::vector<StateInst*>& states);
+
+  // Batched evaluation of the child states (see EvaluateStates). Per factor
+  // arrays hold the entry of state s for main factor f at f * n_states + s.
+  int eval_time_;
+  long eval_version_;
+  std::vector<StateInst*> eval_states_;
+  std::map<int, int> eval_rows_;  // by agent id
+  std::vector<bool> factor_defined_;
+  std::vector<double> factor_wts_;
+  std::vector<TimeCurve> eval_curves_;
+  std::vector<double> eval_factors_;
+  std::vector<double> eval_eqn_;
+  std::vector<int> eval_phase_;  // 0 none, 1 Pursuit, 2 Acquire
+  std::vector<double> eval_likely_;
+
 #pragma cyclus var {							\
     "alias": ["p_conflict_relations", ["states", "primary_state","pair_state"],"relation"], \
     "doc": "Conflict relationships between states at t=0 for Pursuit"\
@@ -133,6 +224,26 @@ bool symmetric;
     }
   std::map<std::pair<std::string,std::string>, int> p_conflict_map ;
 
+  // p_conflict_map and the weapon status of each state, indexed by state
+  // for scoring. Built in Build and kept in step by ChangeConflictReln and
+  // UpdateWeaponStatus.
+  ConflictGraph conflict_graph_;
+
+  // StateInst children, kept by BuildNotify, DecomNotify and the states'
+  // own registration, with the index of each in states_ by agent id
+  std::vector<StateInst*> states_;
+  std::map<int, int> state_index_;
+
+  // Decides which registered states make a decision this timestep
+  void ScheduleDecisions_();
+
+  // timestep of the last ScheduleDecisions_, and whether each registered
+  // state makes a decision then
+  int sched_time_;
+  std::vector<bool> sched_due_;
+
+  long relations_version_;
+
 
 // Defines persistent column names in WeaponProgress table of database
 // Must be defined globally so that references to the column name 
@@ -143,11 +254,9 @@ static std::vector<std::string> column_names;
 std::map<std::string, bool> p_present;
 std::map<std::string, bool> a_present;
 
-// Tracks the weapons status of each state
-std::map<std::string, int> sim_weapon_status;
-
 // Defines conflict scores given weapon status of 2 states and their
-// relationship (ally, neut, enemy)
+// relationship (ally, neut, enemy), keyed by BuildRelationString. Filled
+// from the ConflictScore table for reference; scoring uses the table.
 std::map<std::string, int> score_matrix;
 
   
@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 
+#include "InteractRegion.h"
 #include "cyclus.h"
 
 
@@ -92,8 +93,20 @@ namespace InteractRegionTests {
 }
   */
 
-
-
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+  // Conflict scores are symmetric in the two weapon statuses, and unknown
+  // statuses score as never pursued
+  TEST(InteractRegionTests, ConflictScore) {
+    EXPECT_EQ(2, InteractRegion::ConflictScore(0, 0, 1));
+    EXPECT_EQ(4, InteractRegion::ConflictScore(0, 2, 0));
+    EXPECT_EQ(4, InteractRegion::ConflictScore(2, 0, 0));
+    EXPECT_EQ(10, InteractRegion::ConflictScore(3, 2, -1));
+    EXPECT_EQ(10, InteractRegion::ConflictScore(2, 3, -1));
+    EXPECT_EQ(5, InteractRegion::ConflictScore(3, 3, -1));
+    EXPECT_EQ(1, InteractRegion::ConflictScore(3, -1, 1));
+    EXPECT_EQ(InteractRegion::ConflictScore(0, 2, -1),
+	      InteractRegion::ConflictScore(1, 2, -1));
+  }
 
 } // namespace InteractRegionTests
 } // namespace mbmore
\ No newline at end of file
@@ -34,6 +34,10 @@ RandomEnrich::RandomEnrich(cyclus::Context* ctx)
       feed_recipe(""),
       product_commod(""),
       tails_commod(""),
+      tails_merge_interval(0),
+      tails_max_lots(0),
+      tails_bin_width(1e-4),
+      record_interval(0),
       order_prefs(true){}
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -59,9 +63,10 @@ void RandomEnrich::Build(cyclus::Agent* parent) {
 
   Facility::Build(parent);
   if (initial_feed > 0) {
-    inventory.Push(
-      Material::Create(
-        this, initial_feed, context()->GetRecipe(feed_recipe)));
+    Material::Ptr feed =
+        Material::Create(this, initial_feed, context()->GetRecipe(feed_recipe));
+    inventory.Push(feed);
+    feed_tally_.Add(feed);
   }
 
   LOG(cyclus::LEV_DEBUG2, "EnrFac") << "RandomEnrich "
@@ -69,6 +74,12 @@ void RandomEnrich::Build(cyclus::Agent* parent) {
   LOG(cyclus::LEV_DEBUG2, "EnrFac") << str();
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void RandomEnrich::EnterNotify() {
+  cyclus::Facility::EnterNotify();
+  rng_ = AgentStream(rng_seed, id());
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void RandomEnrich::Tick() {
 
@@ -86,15 +97,14 @@ void RandomEnrich::Tick() {
     trade_timestep = (EveryXTimestep(cur_time, behav_interval));
   }
   else if (social_behav == "Random" && behav_interval > 0) {
-    trade_timestep = (EveryRandomXTimestep(behav_interval, rng_seed));
+    trade_timestep = (EveryRandomXTimestep(behav_interval, rng_));
   }
   else if (social_behav == "None") {
     trade_timestep = 1;
   }
   
   // determine tails assay for the timestep if it is variable
-  curr_tails_assay = RNG_NormalDist(tails_assay, sigma_tails,
-				    rng_seed);
+  curr_tails_assay = RNG_NormalDist(tails_assay, sigma_tails, rng_);
   if (curr_tails_assay < (tails_assay - sigma_tails)) {
     curr_tails_assay = tails_assay - sigma_tails;
   }
@@ -113,8 +123,22 @@ void RandomEnrich::Tock() {
   RecordTimeSeries<cyclus::toolkit::ENRICH_SWU>(this, intra_timestep_swu_);
   RecordTimeSeries<cyclus::toolkit::ENRICH_FEED>(this, intra_timestep_feed_);
 
+  // one tails lot is added per trade, merge them to keep the buffer bounded
+  if (((tails_merge_interval > 0) &&
+       (context()->time() % tails_merge_interval == 0)) ||
+      ((tails_max_lots > 0) && (tails.count() > tails_max_lots))) {
+    ConsolidateLots(&tails, tails_bin_width);
+  }
+
+  // trades are only summarized when record_interval > 0
+  if ((record_interval > 0) &&
+      SummaryDue(context()->time(), record_interval,
+                 context()->sim_info().duration)) {
+    RecordSummary_();
+  }
+
   // Add any inspections to the Inspection table
-  bool do_inspect = EveryRandomXTimestep(inspect_freq, rng_seed);
+  bool do_inspect = EveryRandomXTimestep(inspect_freq, rng_);
   if (do_inspect == true){
     RecordInspection_();
   }
@@ -145,11 +169,6 @@ std::set<cyclus::RequestPortfolio<cyclus::Material>::Ptr>
 //  U-235 content
 void RandomEnrich::AdjustMatlPrefs(
     cyclus::PrefMap<cyclus::Material>::type& prefs) {
-
-  using cyclus::Bid;
-  using cyclus::Material;
-  using cyclus::Request;
-  
   if (order_prefs == false) {
     return;
   }
@@ -158,35 +177,8 @@ void RandomEnrich::AdjustMatlPrefs(
 
   // Loop over all requests
   for (reqit = prefs.begin(); reqit != prefs.end(); ++reqit) {
-    std::vector<Bid<Material>* > bids_vector;    
-    std::map<Bid<Material>*, double>::iterator mit;
-    for (mit = reqit->second.begin(); mit != reqit->second.end(); ++mit) {
-      Bid<Material>* bid = mit->first;
-      bids_vector.push_back(bid);
-    }
-    std::sort (bids_vector.begin(), bids_vector.end(), SortBids); 
-
-    // Assign preferences to the sorted vector
-    double n_bids = bids_vector.size();
-    bool u235_mass = 0;
-
-    for (int bidit = 0 ; bidit < bids_vector.size(); bidit++) {
-      int new_pref = bidit + 1;
-      
-      // For any bids with U-235 qty=0, set pref to zero. 
-      if (!u235_mass) {
-	cyclus::Material::Ptr mat = bids_vector[bidit]->offer();
-	cyclus::toolkit::MatQuery mq(mat);
-	if (mq.mass(922350000) == 0) {
-	  new_pref = -1;
-	}
-	else {
-	  u235_mass = true;
-	}
-      }
-      (reqit->second)[bids_vector[bidit]] = new_pref;
-    } // each bid
-  } // each Material Request
+    RankBidsByU235(&reqit->second);
+  }
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -220,12 +212,14 @@ std::set<cyclus::BidPortfolio<cyclus::Material>::Ptr> RandomEnrich::GetMatlBids(
     
     std::vector<Request<Material>*>& tails_requests =
       out_requests[tails_commod];
+    // offer bids for all tails material, keeping discrete quantities
+    // to preserve possible variation in composition. The lots are read
+    // once and the same offers are shared by every tails request.
+    MatVec mats = tails.PopN(tails.count());
+    tails.Push(mats);
+
     std::vector<Request<Material>*>::iterator it;
     for (it = tails_requests.begin(); it != tails_requests.end(); ++it) {
-      // offer bids for all tails material, keeping discrete quantities
-      // to preserve possible variation in composition 
-      MatVec mats = tails.PopN(tails.count());
-      tails.Push(mats);
       for (int k = 0; k < mats.size(); k++) {
         Material::Ptr m = mats[k];
 	Request<Material>* req = *it;
@@ -254,7 +248,7 @@ std::set<cyclus::BidPortfolio<cyclus::Material>::Ptr> RandomEnrich::GetMatlBids(
     for (it = commod_requests.begin(); it != commod_requests.end(); ++it) {
       Request<Material>* req = *it;
       Material::Ptr mat = req->target();
-      double request_enrich = cyclus::toolkit::UraniumAssay(mat) ;
+      double request_enrich = CompProps(mat).assay;
 
       if (ValidReq(req->target()) && (request_enrich <= max_enrich)) {
         Material::Ptr offer = Offer_(req->target());
@@ -282,10 +276,8 @@ std::set<cyclus::BidPortfolio<cyclus::Material>::Ptr> RandomEnrich::GetMatlBids(
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 bool RandomEnrich::ValidReq(const cyclus::Material::Ptr mat) {
-  cyclus::toolkit::MatQuery q(mat);
-  double u235 = q.atom_frac(922350000);
-  double u238 = q.atom_frac(922380000);
-  return (u238 > 0 && u235 / (u235 + u238) > curr_tails_assay);
+  CompProperties props = CompProps(mat);
+  return (props.u238_atom_frac > 0 && props.assay > curr_tails_assay);
 }
   
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -339,25 +331,12 @@ void RandomEnrich::GetMatlTrades(
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void RandomEnrich::AddMat_(cyclus::Material::Ptr mat) {
   // Elements and isotopes other than U-235, U-238 are sent directly to tails
-  cyclus::CompMap cm = mat->comp()->atom();
-  bool extra_u = false;
-  bool other_elem = false;
-  for (cyclus::CompMap::const_iterator it = cm.begin(); it != cm.end(); ++it) {
-    if (pyne::nucname::znum(it->first) == 92) {
-      if (pyne::nucname::anum(it->first) != 235 &&
-          pyne::nucname::anum(it->first) != 238 && it->second > 0) {
-	extra_u = true;
-      }
-    }
-    else if (it->second > 0) {
-      other_elem = true ;
-    }
-  }
-  if (extra_u) {
+  CompProperties props = CompProps(mat);
+  if (props.extra_u) {
     cyclus::Warn<cyclus::VALUE_WARNING> ("More than 2 isotopes of U.  "  \
       "Istopes other than U-235, U-238 are sent directly to tails.");
   }
-  if (other_elem) {
+  if (props.other_elem) {
     cyclus::Warn<cyclus::VALUE_WARNING> ("Non-uranium elements are "   \
       "sent directly to tails.");
   }
@@ -367,6 +346,7 @@ void RandomEnrich::AddMat_(cyclus::Material::Ptr mat) {
   
   try {
     inventory.Push(mat);
+    feed_tally_.Add(mat);
   }
   catch (cyclus::Error& e) {
     e.msg(Agent::InformErrorMsg(e.msg()));
@@ -388,10 +368,10 @@ cyclus::Material::Ptr RandomEnrich::Request_() {
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 cyclus::Material::Ptr RandomEnrich::Offer_(cyclus::Material::Ptr mat) {
-  cyclus::toolkit::MatQuery q(mat);
+  CompProperties props = CompProps(mat);
   cyclus::CompMap comp;
-  comp[922350000] = q.atom_frac(922350000);
-  comp[922380000] = q.atom_frac(922380000);
+  comp[922350000] = props.u235_atom_frac;
+  comp[922380000] = props.u238_atom_frac;
   return cyclus::Material::CreateUntracked(
            mat->quantity(), cyclus::Composition::CreateFromAtom(comp));
 }
@@ -403,38 +383,26 @@ cyclus::Material::Ptr RandomEnrich::Enrich_(
   using cyclus::Material;
   using cyclus::ResCast;
   using cyclus::toolkit::Assays;
-  using cyclus::toolkit::UraniumAssay;
   using cyclus::toolkit::SwuRequired;
   using cyclus::toolkit::FeedQty;
   using cyclus::toolkit::TailsQty;
 
   // get enrichment parameters
-  double u_assay = UraniumAssay(mat);
+  double u_assay = CompProps(mat).assay;
   Assays assays(FeedAssay(), u_assay, curr_tails_assay);
   double swu_req = SwuRequired(qty, assays);
   double natu_req = FeedQty(qty, assays);
 
   // Determine the composition of the natural uranium
   // (ie. U-235+U-238/TotalMass)
-  Material::Ptr natu_matl=inventory.Pop(inventory.quantity());
-  inventory.Push(natu_matl);
-  
-  cyclus::toolkit::MatQuery mq(natu_matl);
-  std::set<cyclus::Nuc> nucs;
-  nucs.insert(922350000);
-  nucs.insert(922380000);
-  double natu_frac = mq.mass_frac(nucs);
+  SyncFeedTally_();
+  double natu_frac = feed_tally_.UraniumFraction();
   double feed_req = natu_req/natu_frac;
 
-  // pop amount from inventory and blob it into one material
+  // pop exactly the feed needed from inventory, as one material
   Material::Ptr r;
   try {
-    // required so popping doesn't take out too much
-    if (cyclus::AlmostEq(feed_req, inventory.quantity())) {
-      r = cyclus::toolkit::Squash(inventory.PopN(inventory.count()));
-    } else {
-      r = inventory.Pop(feed_req);
-    }
+    r = WithdrawFeed(&inventory, &feed_tally_, feed_req);
   } catch (cyclus::Error& e) {
     NatUConverter nc(FeedAssay(), curr_tails_assay);
     std::stringstream ss;
@@ -495,6 +463,11 @@ void RandomEnrich::RecordRandomEnrich_(double natural_u, double swu) {
   LOG(cyclus::LEV_DEBUG1, "EnrFac") << "  * Amount: " << natural_u;
   LOG(cyclus::LEV_DEBUG1, "EnrFac") << "  *    SWU: " << swu;
 
+  if (record_interval > 0) {
+    trade_summary_.Add(natural_u, swu);
+    return;
+  }
+
   Context* ctx = Agent::context();
   ctx->NewDatum("RandomEnrichs")
       ->AddVal("ID", id())
@@ -503,6 +476,24 @@ void RandomEnrich::RecordRandomEnrich_(double natural_u, double swu) {
       ->AddVal("SWU", swu)
       ->Record();
 }
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void RandomEnrich::RecordSummary_() {
+  if (!trade_summary_.empty()) {
+    context()->NewDatum("RandomEnrichsSummary")
+        ->AddVal("ID", id())
+        ->AddVal("Time", context()->time())
+        ->AddVal("NTrades", trade_summary_.n_trades())
+        ->AddVal("Natural_Uranium", trade_summary_.natu_sum())
+        ->AddVal("Natural_Uranium_Min", trade_summary_.natu_min())
+        ->AddVal("Natural_Uranium_Max", trade_summary_.natu_max())
+        ->AddVal("SWU", trade_summary_.swu_sum())
+        ->AddVal("SWU_Min", trade_summary_.swu_min())
+        ->AddVal("SWU_Max", trade_summary_.swu_max())
+        ->Record();
+  }
+  trade_summary_.Clear();
+}
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void RandomEnrich::RecordInspection_() {
   using cyclus::Context;
@@ -510,8 +501,8 @@ void RandomEnrich::RecordInspection_() {
 
   std::string sample_location = "Cascade";
 
-  // TODO: Add multiple samples to an inspection, rules about only Cascade
-  // having true positives? Or increased chance of true based on location?
+  // TODO: Rules about only Cascade having true positives? Or increased
+  // chance of true based on location?
   // TODO: Make HEU definition a State Var (in Tock)
 
   // If HEU has been made, then we see if a perfect swipe test would find it
@@ -532,7 +523,7 @@ void RandomEnrich::RecordInspection_() {
     // shipping.
     std::cout << "Inspect Time: " << cur_time <<  "  Net HEU produced " << net_heu << std::endl;
     if ((net_heu >= heu_ship_qty) && (heu_ship_qty > 0.0)){
-      HEU_present = XLikely(cur_time/(double(simdur) - 1.0), rng_seed);
+      HEU_present = XLikely(cur_time/(double(simdur) - 1.0), rng_);
       std::cout << "HEU Presence? " << HEU_present << std::endl;
       net_heu -= heu_ship_qty;
     }
@@ -540,56 +531,25 @@ void RandomEnrich::RecordInspection_() {
   else if ((net_heu > 0.0) && (HEU_present == false)){
     // HEU is made/shipped at specific intervals defined by behavior fns,
     // so test whether any has been made/shipped since last inspection
-    HEU_present = XLikely(cur_time/(double(simdur) - 1.0), rng_seed);
+    HEU_present = XLikely(cur_time/(double(simdur) - 1.0), rng_);
   }
 
-  // Each sample is N swipes, analyzed independently (with a high rate of
-  // false readings in practice).
-  // Based on whether HEU is 'detected' in the sample, determine whether or not
-  // any false positives or negatives change the swipe result.
-  int pos_swipes = 0;
-  int n_false_pos = 0;
-  int n_false_neg = 0;
-  
-  for (int swipeit = 0; swipeit < n_swipes; swipeit++) {
-    double prob;
-    if (HEU_present == true){
-      prob = false_neg;
-    }
-    else {
-      prob = false_pos;
-    }
-    bool flip = XLikely(prob, rng_seed);
-    //    std::cout << "Flip? " << flip << std::endl;
-
-    // record false positives, false negatives and net 'positive' swipe results
-    if (flip) {
-      if (!HEU_present){
-	pos_swipes++ ;
-	n_false_pos++;
-      }
-      else {
-	n_false_neg++;
-      }
-    }
-    else {
-      if (HEU_present) { pos_swipes++; }
+  // Cascade is always sampled, other locations only if defined
+  double cascade_false_pos = false_pos;
+  double cascade_false_neg = false_neg;
+  std::map<std::string, std::pair<double, double> >::const_iterator loc_it =
+    sample_locs.find(sample_location);
+  if (loc_it != sample_locs.end()) {
+    cascade_false_pos = loc_it->second.first;
+    cascade_false_neg = loc_it->second.second;
+  }
+  RecordSample_(sample_location, cascade_false_pos, cascade_false_neg);
+  for (loc_it = sample_locs.begin(); loc_it != sample_locs.end(); ++loc_it) {
+    if (loc_it->first != sample_location) {
+      RecordSample_(loc_it->first, loc_it->second.first,
+		    loc_it->second.second);
     }
-    
-    //    if ((HEU_present && !flip) || (!HEU_present && flip)){
-    //      pos_swipes++;
-    //    }
   }
-    
-  Context* ctx = Agent::context();
-  context()->NewDatum("Inspections")
-    ->AddVal("AgentID", id())
-    ->AddVal("Time", context()->time())
-    ->AddVal("SampleLoc", sample_location)
-    ->AddVal("FalsePos", double(n_false_pos)/double(n_swipes))
-    ->AddVal("FalseNeg", double(n_false_neg)/double(n_swipes))
-    ->AddVal("PosSwipeFrac", double(pos_swipes)/double(n_swipes))
-    ->Record();
 
   /*
   LOG(cyclus::LEV_DEBUG1, "EnrFac") << prototype()
@@ -599,6 +559,34 @@ void RandomEnrich::RecordInspection_() {
   */
   
 }
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void RandomEnrich::RecordSample_(const std::string& loc, double loc_false_pos,
+				 double loc_false_neg) {
+  // Each sample is N swipes, analyzed independently (with a high rate of
+  // false readings in practice).
+  // Based on whether HEU is 'detected' in the sample, determine whether or not
+  // any false positives or negatives change the swipe result. Every swipe
+  // flips with the same probability, so the number of flipped swipes is
+  // drawn at once from a binomial distribution.
+  double prob = HEU_present ? loc_false_neg : loc_false_pos;
+  int n_flips = RNG_Binomial(n_swipes, prob, rng_);
+
+  // record false positives, false negatives and net 'positive' swipe results
+  int n_false_pos = HEU_present ? 0 : n_flips;
+  int n_false_neg = HEU_present ? n_flips : 0;
+  int pos_swipes = HEU_present ? (n_swipes - n_flips) : n_flips;
+
+  context()->NewDatum("Inspections")
+    ->AddVal("AgentID", id())
+    ->AddVal("Time", context()->time())
+    ->AddVal("SampleLoc", loc)
+    ->AddVal("FalsePos", double(n_false_pos)/double(n_swipes))
+    ->AddVal("FalseNeg", double(n_false_neg)/double(n_swipes))
+    ->AddVal("PosSwipeFrac", double(pos_swipes)/double(n_swipes))
+    ->Record();
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 // Decide whether each individual bid will be responded to based on whether
 // the enrichment facility is trading
@@ -617,7 +605,7 @@ cyclus::BidPortfolio<cyclus::Material>::Ptr RandomEnrich::ConsiderMatlRequests(
   for (it = commod_requests.begin(); it != commod_requests.end(); ++it) {
     Request<Material>* req = *it;
     Material::Ptr mat = req->target();
-    double request_enrich = cyclus::toolkit::UraniumAssay(mat) ;
+    double request_enrich = CompProps(mat).assay;
     int cur_time = context()->time();
     // if social behavior on and logic says no trade
     if (!trade_timestep) {
@@ -634,14 +622,24 @@ cyclus::BidPortfolio<cyclus::Material>::Ptr RandomEnrich::ConsiderMatlRequests(
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 double RandomEnrich::FeedAssay() {
-  using cyclus::Material;
-
   if (inventory.empty()) {
     return 0;
   }
-  cyclus::Material::Ptr fission_matl = inventory.Pop(inventory.quantity());
-  inventory.Push(fission_matl);
-  return cyclus::toolkit::UraniumAssay(fission_matl); 
+  SyncFeedTally_();
+  return feed_tally_.Assay();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void RandomEnrich::SyncFeedTally_() {
+  if (cyclus::AlmostEq(feed_tally_.quantity(), inventory.quantity())) {
+    return;
+  }
+  cyclus::toolkit::MatVec mats = inventory.PopN(inventory.count());
+  inventory.Push(mats);
+  feed_tally_.Clear();
+  for (int i = 0; i < mats.size(); i++) {
+    feed_tally_.Add(mats[i]);
+  }
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
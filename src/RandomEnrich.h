@@ -3,85 +3,14 @@
 
 #include <string>
 
+#include "behavior_functions.h"
 #include "cyclus.h"
+#include "enrich_converters.h"
+#include "enrich_functions.h"
 #include "sim_init.h"
 
 namespace mbmore {
 
-/// @class SWUConverter
-///
-/// @brief The SWUConverter is a simple Converter class for material to
-/// determine the amount of SWU required for their proposed enrichment
-class SWUConverter : public cyclus::Converter<cyclus::Material> {
- public:
-  SWUConverter(double feed_commod, double tails) : feed_(feed_commod),
-    tails_(tails) {}
-  virtual ~SWUConverter() {}
-
-  /// @brief provides a conversion for the SWU required
-  virtual double convert(
-      cyclus::Material::Ptr m,
-      cyclus::Arc const * a = NULL,
-      cyclus::ExchangeTranslationContext<cyclus::Material>
-          const * ctx = NULL) const {
-    cyclus::toolkit::Assays assays(feed_, cyclus::toolkit::UraniumAssay(m),
-                                   tails_);
-    return cyclus::toolkit::SwuRequired(m->quantity(), assays);
-  }
-
-  /// @returns true if Converter is a SWUConverter and feed and tails equal
-  virtual bool operator==(Converter& other) const {
-    SWUConverter* cast = dynamic_cast<SWUConverter*>(&other);
-    return cast != NULL &&
-    feed_ == cast->feed_ &&
-    tails_ == cast->tails_;
-  }
-
- private:
-  double feed_, tails_;
-};
-
-/// @class NatUConverter
-///
-/// @brief The NatUConverter is a simple Converter class for material to
-/// determine the amount of natural uranium required for their proposed
-/// enrichment
-class NatUConverter : public cyclus::Converter<cyclus::Material> {
- public:
-  NatUConverter(double feed_commod, double tails) : feed_(feed_commod),
-    tails_(tails) {}
-  virtual ~NatUConverter() {}
-
-  /// @brief provides a conversion for the amount of natural Uranium required
-  virtual double convert(
-      cyclus::Material::Ptr m,
-      cyclus::Arc const * a = NULL,
-      cyclus::ExchangeTranslationContext<cyclus::Material>
-          const * ctx = NULL) const {
-    cyclus::toolkit::Assays assays(feed_, cyclus::toolkit::UraniumAssay(m),
-                                   tails_);
-    cyclus::toolkit::MatQuery mq(m);
-    std::set<cyclus::Nuc> nucs;
-    nucs.insert(922350000);
-    nucs.insert(922380000);
-
-    double natu_frac = mq.mass_frac(nucs);
-    double natu_req = cyclus::toolkit::FeedQty(m->quantity(), assays);
-    return natu_req / natu_frac;
-  }
-
-  /// @returns true if Converter is a NatUConverter and feed and tails equal
-  virtual bool operator==(Converter& other) const {
-    NatUConverter* cast = dynamic_cast<NatUConverter*>(&other);
-    return cast != NULL &&
-    feed_ == cast->feed_ &&
-    tails_ == cast->tails_;
-  }
-
- private:
-  double feed_, tails_;
-};
-
 ///  The RandomEnrich is based on the Cycamore Enrich facility.
 ///  It is a simple Agent that enriches natural
 ///  uranium in a Cyclus simulation. It does not explicitly compute
@@ -179,6 +108,9 @@ class RandomEnrich : public cyclus::Facility {
   // --- Facility Members ---
   /// perform module-specific tasks when entering the simulation
   virtual void Build(cyclus::Agent* parent);
+
+  /// seeds this agent's random number stream
+  virtual void EnterNotify();
   // ---
 
   // --- Agent Members ---
@@ -287,14 +219,27 @@ class RandomEnrich : public cyclus::Facility {
   ///  @brief calculates the feed assay based on the unenriched inventory
   double FeedAssay();
 
+  ///  @brief rebuilds feed_tally_ from the inventory if they are out of
+  ///  step (e.g. after a restart, when only the inventory is restored)
+  void SyncFeedTally_();
+
   ///  @brief records and enrichment with the cyclus::Recorder
   void RecordRandomEnrich_(double natural_u, double swu);
 
+  ///  @brief records the trades summarized since the last summary as one
+  ///  row of the RandomEnrichsSummary table, then clears the summary
+  void RecordSummary_();
+
   /// @brief if an inspection is performed, the resulting fraction of
   /// positive swipes/total swipes is recorded in the database for each
   /// unique sampling location
   void RecordInspection_();
 
+  /// @brief records the swipe results of one sample of n_swipes taken at
+  /// loc, given whether HEU is present and the swipe error rates there
+  void RecordSample_(const std::string& loc, double loc_false_pos,
+                     double loc_false_neg);
+
   #pragma cyclus var { \
     "tooltip": "feed commodity",					\
     "doc": "feed commodity that the enrichment facility accepts",	\
@@ -327,6 +272,38 @@ class RandomEnrich : public cyclus::Facility {
   }
   std::string tails_commod;
 
+  #pragma cyclus var { \
+    "default" : 0, "tooltip" : "tails merging interval (timesteps)", \
+    "uilabel" : "Tails Merging Interval", \
+    "doc" : "merge tails lots of similar assay every this many timesteps " \
+            "(0 to only merge on tails_max_lots)" }
+  int tails_merge_interval;
+
+  #pragma cyclus var { \
+    "default" : 0, "tooltip" : "maximum number of tails lots", \
+    "uilabel" : "Maximum Tails Lots", \
+    "doc" : "merge tails lots of similar assay whenever the tails buffer " \
+            "holds more than this many lots (0 to only merge on " \
+            "tails_merge_interval)" }
+  int tails_max_lots;
+
+  #pragma cyclus var { \
+    "default" : 1e-4, "tooltip" : "assay bin width for merging tails", \
+    "uilabel" : "Tails Merging Assay Bin", \
+    "doc" : "tails lots are merged when their U235 assays fall in the same " \
+            "bin of this width" }
+  double tails_bin_width;
+
+  #pragma cyclus var { \
+    "default" : 0, "tooltip" : "enrichment recording interval (timesteps)", \
+    "uilabel" : "Enrichment Recording Interval", \
+    "doc" : "0 records every trade in the RandomEnrichs table. N > 0 instead " \
+            "records one row per N timesteps in the RandomEnrichsSummary table, " \
+            "with the number of trades and the sum, minimum and maximum of " \
+            "their natural uranium and SWU. Trades since the last summary " \
+            "row are not saved, so they are lost on a restart" }
+  int record_interval;
+
   #pragma cyclus var {							\
     "default": 0.003, "tooltip": "tails assay",				\
     "uilabel": "Tails Assay",                               \
@@ -434,10 +411,25 @@ class RandomEnrich : public cyclus::Facility {
 			     "individually to each swipe in a sample"}
   double false_neg;
 
+  #pragma cyclus var {"default": {}, \
+                      "alias": ["sample_locs", "location", \
+                                ["rates", "false_pos", "false_neg"]], \
+                      "tooltip": "additional inspection sample locations", \
+                      "doc": "sample locations swiped at each inspection in "\
+                             "addition to Cascade, each with its own "\
+                             "(false_pos, false_neg) swipe rates. An entry "\
+                             "for Cascade replaces false_pos and false_neg "\
+                             "there."}
+  std::map<std::string, std::pair<double, double> > sample_locs;
+
   #pragma cyclus var {"default": 0, "tooltip": "Seed for RNG" ,		\
                           "doc": "seed on current system time if set to -1," \
                                  " otherwise seed on number defined"}
   int rng_seed;
+
+  // Random number stream of this agent, seeded from rng_seed and the agent
+  // id when it enters the simulation
+  RNGStream rng_;
   //***
   
   #pragma cyclus var {						       \
@@ -453,6 +445,10 @@ class RandomEnrich : public cyclus::Facility {
 
   #pragma cyclus var { 'capacity': 'max_feed_inventory' }
   cyclus::toolkit::ResBuf<cyclus::Material> inventory;  // natural u
+
+  // U235/U238 content of the inventory, kept up to date on every push and
+  // pop so the feed assay is a constant time read
+  UraniumTally feed_tally_;
   #pragma cyclus var {}
   cyclus::toolkit::ResBuf<cyclus::Material> tails;  // depleted u
 
@@ -460,6 +456,10 @@ class RandomEnrich : public cyclus::Facility {
   // these help enable time series generation.
   double intra_timestep_swu_;
   double intra_timestep_feed_;
+
+  // trades not yet recorded when record_interval > 0 (not a state
+  // variable, so lost on restart)
+  TradeSummary trade_summary_;
   
   friend class RandomEnrichTest;
   // ---
@@ -695,5 +695,109 @@ TEST(RandomEnrichTests, TestInspectionPositives) {
   
   } 
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+  TEST(RandomEnrichTests, TestInspectionLocations) {
+    // Extra sample locations are recorded at every inspection with their
+    // own false positive rates (no HEU is produced)
+
+ std::string config = 
+    "   <feed_commod>natu</feed_commod> "
+    "   <feed_recipe>natu1</feed_recipe> "
+    "   <product_commod>enr_u</product_commod> "
+    "   <tails_commod>tails</tails_commod> "
+    "   <tails_assay>0.002</tails_assay> "
+    "   <inspect_freq>1</inspect_freq> "
+    "   <n_swipes>1000</n_swipes> "
+    "   <false_pos>0</false_pos> "
+    "   <sample_locs> "
+    "     <item> "
+    "       <location>Vault</location> "
+    "       <rates><false_pos>1</false_pos><false_neg>0</false_neg></rates> "
+    "     </item> "
+    "     <item> "
+    "       <location>Feed</location> "
+    "       <rates><false_pos>0.3</false_pos><false_neg>0</false_neg></rates> "
+    "     </item> "
+    "   </sample_locs> ";
+
+  int simdur = 10;
+  cyclus::MockSim sim(cyclus::AgentSpec
+		      (":mbmore:RandomEnrich"), config, simdur);
+  sim.AddRecipe("natu1", c_natu1());
+  sim.AddRecipe("enr_u", c_leu());
+  
+  sim.AddSource("natu")
+    .recipe("natu1")
+    .capacity(1.0)
+    .Finalize();
+  sim.AddSink("enr_u")
+    .recipe("enr_u")
+    .Finalize();
+  
+  int id = sim.Run();
+  QueryResult qr = sim.db().Query("Inspections", NULL);
+  EXPECT_EQ(qr.rows.size(), 3 * simdur);
+
+  for (int it = 0; it < qr.rows.size(); it++) {
+    std::string loc = qr.GetVal<std::string>("SampleLoc", it);
+    double posfrac = qr.GetVal<double>("PosSwipeFrac", it);
+    if (loc == "Cascade") {
+      EXPECT_EQ(posfrac, 0);
+    } else if (loc == "Vault") {
+      EXPECT_EQ(posfrac, 1);
+    } else {
+      EXPECT_NEAR(posfrac, 0.3, 0.1);
+    }
+  }
+  }
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+  TEST(RandomEnrichTests, TestRecordInterval) {
+    // With record_interval set, trades are recorded as one summary row per
+    // interval (0-1, 2-3 and the short final interval 4)
+
+  std::string config = 
+    "   <feed_commod>natu</feed_commod> "
+    "   <feed_recipe>natu1</feed_recipe> "
+    "   <product_commod>leu</product_commod> "
+    "   <tails_commod>tails</tails_commod> "
+    "   <tails_assay>0.003</tails_assay> "
+    "   <record_interval>2</record_interval> ";
+
+  int simdur = 5;
+  cyclus::MockSim sim(cyclus::AgentSpec
+		      (":mbmore:RandomEnrich"), config, simdur);
+  sim.AddRecipe("natu1", c_natu1());
+  sim.AddRecipe("leu", c_leu());
+
+  sim.AddSource("natu")
+    .recipe("natu1")
+    .Finalize();
+  sim.AddSink("leu")
+    .capacity(1)
+    .recipe("leu")
+    .Finalize();
+  
+  int id = sim.Run();
+
+  // product is traded from timestep 1 on, once the feed has arrived
+  std::vector<Cond> conds;
+  conds.push_back(Cond("Commodity", "==", std::string("leu")));
+  QueryResult trades = sim.db().Query("Transactions", &conds);
+  EXPECT_GT(trades.rows.size(), 0);
+
+  QueryResult qr = sim.db().Query("RandomEnrichsSummary", NULL);
+  EXPECT_EQ(qr.rows.size(), 3);
+  int n_trades = 0;
+  for (int it = 0; it < qr.rows.size(); it++) {
+    int time = qr.GetVal<int>("Time", it);
+    EXPECT_TRUE(time == 1 || time == 3 || time == 4);
+    n_trades += qr.GetVal<int>("NTrades", it);
+    EXPECT_LE(qr.GetVal<double>("SWU_Min", it),
+	      qr.GetVal<double>("SWU_Max", it));
+  }
+  EXPECT_EQ(n_trades, trades.rows.size());
+  }
+
 } // namespace randomenrichtests
 } // namespace mbmore
@@ -24,6 +24,12 @@ RandomSink::RandomSink(cyclus::Context* ctx)
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 RandomSink::~RandomSink() {}
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void RandomSink::EnterNotify() {
+  cyclus::Facility::EnterNotify();
+  rng_ = AgentStream(rng_seed, id());
+}
+
 #pragma cyclus def schema mbmore::RandomSink
 
 #pragma cyclus def annotations mbmore::RandomSink
@@ -183,7 +189,7 @@ void RandomSink::Tick() {
   // one randomly
   int n_recipes = recipe_names.size();
   if (n_recipes > 0) {
-    int curr_recipe_index = RNG_Integer(0.0, n_recipes, rng_seed);
+    int curr_recipe_index = RNG_Integer(0.0, n_recipes, rng_);
     curr_recipe = context()->GetRecipe(recipe_names[curr_recipe_index]);
   }
   else {
@@ -197,7 +203,7 @@ void RandomSink::Tick() {
   
   /// determine the amount to request
   // If sigma=0 then RNG is not queried
-  double desired_amt = RNG_NormalDist(avg_qty, sigma, rng_seed);
+  double desired_amt = RNG_NormalDist(avg_qty, sigma, rng_);
   amt = std::min(desired_amt, std::max(0.0, inventory.space()));
 
   if (cur_time < t_trade) {
@@ -213,7 +219,7 @@ void RandomSink::Tick() {
   }
   // Call EveryRandom only if the agent REALLY want it (dummyproofing)
   else if ((social_behav == "Random") && (amt > 0)){
-    if (!EveryRandomXTimestep(behav_interval, rng_seed)) // HEU randomly one in X times
+    if (!EveryRandomXTimestep(behav_interval, rng_)) // HEU randomly one in X times
       {
 	std::cout << "Amt is zero because Random is negatvive " << std::endl;
 	amt = 0;
@@ -221,7 +227,7 @@ void RandomSink::Tick() {
   }
   // If reference, query RNG but force trade as zero quantity.
   else if ((social_behav == "Reference") && (amt > 0)){
-    bool res = EveryRandomXTimestep(behav_interval, rng_seed);
+    bool res = EveryRandomXTimestep(behav_interval, rng_);
     std::cout << "Amt is zero because Reference superficially queries RNG " << std::endl;
     amt = 0;
   }
@@ -52,6 +52,9 @@ class RandomSink : public cyclus::Facility  {
 
   virtual std::string str();
 
+  /// seeds this agent's random number stream
+  virtual void EnterNotify();
+
   virtual void Tick();
 
   virtual void Tock();
@@ -140,6 +143,10 @@ class RandomSink : public cyclus::Facility  {
                                " otherwise seed on number defined"}
   int rng_seed;
 
+  // Random number stream of this agent, seeded from rng_seed and the agent
+  // id when it enters the simulation
+  RNGStream rng_;
+
   #pragma cyclus var {"default": 1e299, "tooltip": "sink avg_qty",	\
                           "doc": "mean for the normal distribution that " \
                                  "is sampled to determine the amount of " \
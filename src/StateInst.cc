@@ -2,13 +2,17 @@
 #include "StateInst.h"
 #include "InteractRegion.h"
 #include "behavior_functions.h"
+#include <algorithm>
 #include <cmath>
 
 namespace mbmore {
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 StateInst::StateInst(cyclus::Context* ctx)
-  : cyclus::Institution(ctx){
+  : cyclus::Institution(ctx),
+    event_driven(false),
+    change_points_built_(false),
+    piecewise_constant_(true) {
     //    kind("State"){
   cyclus::Warn<cyclus::EXPERIMENTAL_WARNING>("the StateInst agent is experimental.");
 }
@@ -28,7 +32,14 @@ void StateInst::DecomNotify(Agent* a) {
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void StateInst::EnterNotify() {
   cyclus::Institution::EnterNotify();
+  rng_ = AgentStream(rng_seed, id());
 
+  // the region keeps a registry of its states
+  InteractRegion* pseudo_region =
+    dynamic_cast<InteractRegion*>(this->parent());
+  if (pseudo_region != NULL) {
+    pseudo_region->RegisterState(this);
+  }
 
   //TODO: IS THIS NECESSARY?
   using cyclus::toolkit::CommodityProducer;
@@ -110,7 +121,7 @@ void StateInst::Tick() {
 	  && (constants.size() == 2)){
 	double y0 = constants[0];
 	double yf = constants[1];
-	int t_change = RNG_Integer(0, simdur, rng_seed);
+	int t_change = RNG_Integer(0, simdur, rng_);
 	// add the t_change to the P_f record
 	eqn_it->second.second.push_back(t_change);
       }
@@ -121,7 +132,7 @@ void StateInst::Tick() {
 	  && (constants.size() == 1)){
 	double yf = constants[0];
 	if (std::abs(yf) <= 1){
-	  int t_change = RNG_Integer(0, simdur, rng_seed);
+	  int t_change = RNG_Integer(0, simdur, rng_);
 	  eqn_it->second.second.push_back(t_change);
 	}
       }
@@ -135,6 +146,10 @@ void StateInst::Tock() {
 
   InteractRegion* pseudo_region =
     dynamic_cast<InteractRegion*>(this->parent());
+  // In event driven mode most timesteps have no decision to make
+  if (!pseudo_region->DecisionDue(this)) {
+    return;
+  }
   Agent* me = this;
   std::string proto = me->prototype();
   // Pursuit (if detected) and acquire each change the conflict map
@@ -223,83 +238,69 @@ void StateInst::DeploySecret() {
   d->AddVal("AgentId", cyclus::Agent::id());
   d->AddVal("EqnType", eqn_type);
 
-  std::map <std::string, double> P_wt;
-  std::map <std::string, double> P_factors;
-
   // Make a pointer to my parent region so I can access the RegionLevel
   // variables (in a similar way to how the Context provides simulation
   // level information)
   InteractRegion* pseudo_region =
     dynamic_cast<InteractRegion*>(this->parent());
-  
-  // All defined factors should be recorded with their actual value
-  P_wt = pseudo_region->GetWeights("Pursuit");
-  // Even if state is already pursuing and working toward acquire, the success
-  // rate is determined by the value of the pursuit factors, so score must be
-  // calculated
+
+  // The region evaluates the factors and pursuit equation of all states
+  // together, once per timestep. Even if state is already pursuing and
+  // working toward acquire, the success rate is determined by the value of
+  // the pursuit factors.
+  int row = pseudo_region->WeaponEqnRow(this);
   
   // Any factors not defined for sim should have a value of zero in the table
   std::vector<std::string>& main_factors = pseudo_region->GetMainFactors();
-  std::map<std::string, bool> present = pseudo_region->DefinedFactors("Pursuit");
-
-  double pursuit_eqn = 0;
 
   // Iterate through main list of factors. If not present then record 0
-  // in database. If present then calculate current value based on time
-  // dynamics
+  // in database. If present then record the current value
   for(int f = 0; f < main_factors.size(); f++){
     const std::string& factor = main_factors[f];
-    bool f_defined  = present[std::string(factor)];
-    // for most factors 'relation' defines the function for time dynamics of
-    // the factor. But for Conflict, 'relation' is the pair state in the
-    // relationship
-    std::string relation = P_f[factor].first;
-    std::vector<double> constants =  P_f[factor].second;
 
     // Record zeroes for any columns not defined in input file
-    if (!f_defined) {
+    if (!pseudo_region->FactorDefined(f)) {
       d->AddVal(factor.c_str(), 0.0);
     }
     else {
-      double factor_curr_y;
-      // Determine the State's conflict score for this timestep
-      int n_states = pseudo_region->GetNStates();
-      if (factor == "Conflict"){
-	if (n_states <= 1){
-	  factor_curr_y = 0;
-	}
-	else{
-	  Agent* me = this;
-	  std::string proto = me->prototype();
-	  factor_curr_y =
-	    pseudo_region->GetConflictScore("Pursuit", proto);
-	  // Then check conflict value to see if it needs to change. If
-	  //constants is a single element then it doesn't have a time-based
-	  // change. This change is not propogated until the NEXT timestep
-	  // This is done last because changing conflict for one state will
-	  // also affect another state whose score for this timestep may have
-	  // already been calculated.
-	  if ((constants.size() > 1) && (constants[1] == context()->time())){
-	    int new_val = std::round(constants[0]);
-	    // TODO: THIS SHOULD BE eqn_Type not PURSUIT (but doesn't really matteR)
-	    pseudo_region->ChangeConflictReln("Pursuit", proto,
-				      relation, new_val); 
-	  }
+      d->AddVal(factor.c_str(), pseudo_region->WeaponEqnFactor(row, f));
+
+      // Then check conflict value to see if it needs to change. If
+      // constants is a single element then it doesn't have a time-based
+      // change. This change is not propogated until the NEXT timestep,
+      // as all states have already been scored for this one.
+      // For Conflict the pair in P_f is (other state, [value, time]).
+      std::map<std::string, std::pair<std::string, std::vector<double> > >::
+	const_iterator f_it = P_f.find(factor);
+      if ((factor == "Conflict") && (f_it != P_f.end())) {
+	const std::string& relation = f_it->second.first;
+	const std::vector<double>& constants = f_it->second.second;
+	if ((constants.size() > 1) && (constants[1] == context()->time()) &&
+	    (pseudo_region->GetNStates() > 1)){
+	  int new_val = std::round(constants[0]);
+	  // TODO: THIS SHOULD BE eqn_Type not PURSUIT (but doesn't really matteR)
+	  pseudo_region->ChangeConflictReln("Pursuit", prototype(),
+					    relation, new_val);
 	}
       }
-      else {
-	factor_curr_y = CalcYVal(relation, constants,context()->time());
-      }
-      pursuit_eqn += (factor_curr_y * P_wt[factor]);
-      P_factors[factor] = factor_curr_y;
-      d->AddVal(factor.c_str(), factor_curr_y);
     }
   }
   // Convert pursuit eqn result to a Y/N decision
   // GetLikely requires an input value between 0-10, and the function type
   // should be normalized to convert that value to have a max of y=1.0 for x=10
-  double likely = pseudo_region->GetLikely(eqn_type, pursuit_eqn);
-  bool decision = XLikely(likely, rng_seed);
+  double pursuit_eqn = pseudo_region->WeaponEqnVal(row);
+  double likely = pseudo_region->WeaponEqnLikely(row, eqn_type);
+  int time = context()->time();
+  bool decision;
+  if (event_driven) {
+    long version = pseudo_region->EvalVersion();
+    decision = schedule_.Decide(time, version, likely, rng_);
+    schedule_.Schedule(time, version, likely, decision,
+		       NextChangePoint_(time), simdur, rng_);
+  }
+  else {
+    decision = XLikely(likely, rng_);
+  }
 
   d->AddVal("EqnVal", pursuit_eqn);
   d->AddVal("Likelihood", likely);
@@ -307,8 +308,79 @@ void StateInst::DeploySecret() {
   d->Record();
   return decision;  
 }
-  
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool StateInst::DecisionDue(int time, long relations_version) const {
+  // only states that are not pursuing or are pursuing make decisions
+  if ((weapon_status != 0) && (weapon_status != 2)) {
+    return false;
+  }
+  if (!event_driven) {
+    return true;
+  }
+  return schedule_.Due(time, relations_version);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+int StateInst::NextChangePoint_(int time) {
+  InteractRegion* pseudo_region =
+    dynamic_cast<InteractRegion*>(this->parent());
+
+  if (!change_points_built_) {
+    std::vector<std::string>& main_factors = pseudo_region->GetMainFactors();
+    for (int f = 0; f < main_factors.size(); f++) {
+      if (!pseudo_region->FactorDefined(f)) {
+	continue;
+      }
+      if (main_factors[f] == "Conflict") {
+	// scheduled change to a relation (made in WeaponDecision)
+	std::map<std::string, std::pair<std::string, std::vector<double> > >::
+	  const_iterator f_it = P_f.find("Conflict");
+	if ((f_it != P_f.end()) && (f_it->second.second.size() > 1)) {
+	  change_points_.push_back(std::ceil(f_it->second.second[1]));
+	}
+	continue;
+      }
+      TimeCurve curve = FactorCurve(main_factors[f]);
+      if (!curve.PiecewiseConstant()) {
+	piecewise_constant_ = false;
+      }
+      else if (curve.NextChange(-HUGE_VAL) < HUGE_VAL) {
+	change_points_.push_back(std::ceil(curve.NextChange(-HUGE_VAL)));
+      }
+    }
+    std::sort(change_points_.begin(), change_points_.end());
+    change_points_built_ = true;
+  }
+
+  if (!piecewise_constant_) {
+    return time + 1;
+  }
+  std::vector<int>::const_iterator it =
+    std::upper_bound(change_points_.begin(), change_points_.end(), time);
+  return (it == change_points_.end()) ? simdur : *it;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// A factor that is weighted by the region but missing from P_f has no
+// function, which TimeCurve rejects. A random Step only gets its change time
+// in the time 0 Tick, so curves must not be parsed earlier (e.g. in
+// EnterNotify); the region parses them lazily in its Tock.
+TimeCurve StateInst::FactorCurve(const std::string& factor) const {
+  std::map<std::string, std::pair<std::string, std::vector<double> > >::
+    const_iterator f_it = P_f.find(factor);
+  if (f_it == P_f.end()) {
+    return TimeCurve("", std::vector<double>());
+  }
+  const std::string& function = f_it->second.first;
+  if ((function == "Step" || function == "step") &&
+      (f_it->second.second.size() == 2)) {
+    throw cyclus::ValueError("Random step for factor " + factor +
+			     " has no change time before the first Tick");
+  }
+  return TimeCurve(f_it->second.first, f_it->second.second);
+}
+  
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void StateInst::WriteProducerInformation(
   cyclus::toolkit::CommodityProducer* producer) {
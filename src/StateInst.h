@@ -1,6 +1,7 @@
 #ifndef MBMORE_SRC_STATE_INST_H_
 #define MBMORE_SRC_STATE_INST_H_
 
+#include "behavior_functions.h"
 #include "cyclus.h"
 
 namespace mbmore {
@@ -51,6 +52,20 @@ class StateInst
   // start pursuing a weapon at each timestep.
   bool WeaponDecision(std::string eqn_type);
 
+  // Time dynamics of a pursuit factor (other than Conflict) from P_f.
+  // Throws as CalcYVal does if the factor is not defined, and for a random
+  // Step before Tick has drawn its change time.
+  TimeCurve FactorCurve(const std::string& factor) const;
+
+  // not pursuing (0), pursuing (2), acquired (3)
+  int WeaponStatus() const { return weapon_status; }
+
+  // True if the state makes a weapon decision at time, given the region's
+  // RelationsVersion. Always true while not pursuing or pursuing, unless
+  // event_driven, when only the sampled decision time, change points of
+  // the pursuit factors and changes to relations are due.
+  bool DecisionDue(int time, long relations_version) const;
+
   virtual void Tick();
 
   virtual void Tock();
@@ -75,6 +90,11 @@ class StateInst
   /// unregister a child
   void Unregister_(cyclus::Agent* agent);
 
+  // First timestep after time at which the pursuit factors change value:
+  // time + 1 if any factor is not piecewise constant, or simdur if none
+  // changes again
+  int NextChangePoint_(int time);
+
   // Find the simulation duration
   //  cyclus::SimInfo si_;
   int simdur = context()->sim_info().duration;
@@ -112,6 +132,34 @@ class StateInst
            " otherwise seed on number defined"}
   int rng_seed;
 
+  // Random number stream of this agent, seeded from rng_seed and the agent
+  // id when it enters the simulation
+  RNGStream rng_;
+
+  #pragma cyclus var { \
+    "default": 0, \
+    "tooltip": "Event driven weapon decisions", \
+    "doc": "If True, then while the pursuit equation is constant (all " \
+           "factors constant or step functions) the time of the next " \
+           "successful decision is drawn directly from the geometric " \
+           "distribution, and the equation is only evaluated and recorded " \
+           "at that time, at step changes and after changes to conflict " \
+           "relations or weapon statuses. Decisions have the same " \
+           "distribution as when drawn every timestep. The schedule is " \
+           "not saved, so it is redrawn after a restart."}
+  bool event_driven;
+
+  // event_driven schedule of weapon decisions, versioned by the region's
+  // RelationsVersion. It is not a state variable: after a restart the
+  // first timestep makes a decision and draws a new schedule, which has
+  // the same distribution because the geometric draw is memoryless.
+  DecisionSchedule schedule_;
+
+  // change points of the pursuit factors, found on the first decision
+  bool change_points_built_;
+  bool piecewise_constant_;
+  std::vector<int> change_points_;
+
 
   #pragma cyclus var { \
     "alias": ["pursuit_factors", "factor", ["function","name", ["params","val"]]], \
@@ -3,10 +3,89 @@
 #include <cstdlib>
 #include <iostream>
 #include <cmath>
+#include <algorithm>
+#include <limits>
 
-bool seeded;
 namespace mbmore {
-  
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+namespace {
+
+uint64_t SplitMix64(uint64_t* x) {
+  uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+uint64_t Rotl(uint64_t x, int k) {
+  return (x << k) | (x >> (64 - k));
+}
+
+// Stream used by the functions that take an int rng_seed, seeded on the
+// first call
+RNGStream& SharedStream(int rng_seed) {
+  static RNGStream rng;
+  static bool seeded = false;
+  if (!seeded) {
+    rng = AgentStream(rng_seed, 0);
+    seeded = true;
+  }
+  return rng;
+}
+
+}  // namespace
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+RNGStream::RNGStream() {
+  Seed(0, 0);
+}
+
+RNGStream::RNGStream(uint64_t seed, uint64_t stream) {
+  Seed(seed, stream);
+}
+
+// The seed and stream are hashed separately and combined, then expanded
+// into the 256 bit state with splitmix64 (as recommended for xoshiro).
+void RNGStream::Seed(uint64_t seed, uint64_t stream) {
+  uint64_t a = seed;
+  uint64_t b = stream ^ 0x6a09e667f3bcc909ULL;
+  uint64_t x = SplitMix64(&a) ^ Rotl(SplitMix64(&b), 32);
+  for (int i = 0; i < 4; i++) {
+    s_[i] = SplitMix64(&x);
+  }
+}
+
+RNGStream::result_type RNGStream::operator()() {
+  uint64_t result = Rotl(s_[1] * 5, 7) * 9;
+  uint64_t t = s_[1] << 17;
+  s_[2] ^= s_[0];
+  s_[3] ^= s_[1];
+  s_[1] ^= s_[2];
+  s_[0] ^= s_[3];
+  s_[2] ^= t;
+  s_[3] = Rotl(s_[3], 45);
+  return result;
+}
+
+// top 53 bits as a double in [0, 1)
+double RNGStream::Uniform() {
+  return ((*this)() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+void RNGStream::Uniform(double* out, int n) {
+  for (int i = 0; i < n; i++) {
+    out[i] = Uniform();
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+RNGStream AgentStream(int rng_seed, int agent_id) {
+  uint64_t seed = (rng_seed == -1) ? static_cast<uint64_t>(time(0))
+                                   : static_cast<uint64_t>(rng_seed);
+  return RNGStream(seed, static_cast<uint64_t>(agent_id));
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 bool EveryXTimestep(int curr_time, int interval) {
   // true when there is no remainder, so it is the Xth timestep
@@ -15,32 +94,21 @@ bool EveryXTimestep(int curr_time, int interval) {
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 bool EveryRandomXTimestep(int frequency, int rng_seed) {
+  return EveryRandomXTimestep(frequency, SharedStream(rng_seed));
+}
+
+bool EveryRandomXTimestep(int frequency, RNGStream& rng) {
   //TODO: Doesn't work for a frequency of 1
   if (frequency == 0) {
     return false;
   }
 
-  if (!seeded) {
-    if (rng_seed == -1) {
-      srand(time(0));    // seed random
-    }
-    else {
-      srand(rng_seed);   // user-defined fixed seed
-    }
-    seeded = true;
-  }
-
   // Because this relies on integer rounding, it fails for a frequency of
   // 1 because the midpoint rounds to zero.
   double midpoint;
   (frequency == 1) ? (midpoint = 1) : (midpoint = frequency / 2);
     
-  // The interwebs say that rand is not truly random.
-  //  tRan = rand() % frequency;
-  double cur_rand = rand();
-  int tRan = 1 + (cur_rand*(1.0/(RAND_MAX+1.0))) * frequency;
-  //  int tRan = 1 + uniform_deviate_(rand()) * frequency;
-  //  std::cout << "tRan: " << tRan << " midpoint " << midpoint << std::endl;
+  int tRan = 1 + rng.Uniform() * frequency;
   
   if (tRan == midpoint) {
     return true;
@@ -53,95 +121,68 @@ bool EveryRandomXTimestep(int frequency, int rng_seed) {
 // Returns true for this instance with a particular likelihood of getting a
 // True over all instances.
 
-  bool XLikely(double prob, int rng_seed) {
-
-    /*
-  if (prob == 0) {
-    return false;
-  }
-    */
-    
-  if (!seeded) {
-    if (rng_seed == -1) {
-      srand(time(0));    // seed random
-    }
-    else {
-      srand(rng_seed);   // user-defined fixed seed
-    }
-    seeded = true;
-  }
-
-  double cur_rand = rand();
-  double tRan = (cur_rand/RAND_MAX);
+bool XLikely(double prob, int rng_seed) {
+  return XLikely(prob, SharedStream(rng_seed));
+}
 
-  if (tRan <= prob) {
-    return true;
-  } else {
-   return false;
-  }
+bool XLikely(double prob, RNGStream& rng) {
+  return rng.Uniform() < prob;
 }
 
-// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-/*
-bool EveryRandomXTimestep(int frequency) {
-  bool time_seed = 0 ;
-  return EveryRandomXTimestep(frequency, time_seed);
+void XLikely(double prob, RNGStream& rng, bool* out, int n) {
+  for (int i = 0; i < n; i++) {
+    out[i] = rng.Uniform() < prob;
+  }
 }
-*/
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 // Use Box-Muller algorithm to make a random number sampled from
 // a normal distribution
 
 double RNG_NormalDist(double mean, double sigma, int rng_seed) {
+  return RNG_NormalDist(mean, sigma, SharedStream(rng_seed));
+}
+
+double RNG_NormalDist(double mean, double sigma, RNGStream& rng) {
 
   if (sigma == 0 ) {
     return mean ;
   }
 
-  static double n2 = 0.0;
-  static int n2_cached = 0;
-
-  double result ;
   double x, y, r;
-  double rand1, rand2;
-
-  if (!seeded) {
-    if (rng_seed == -1) {
-      srand(time(0)); // if seeding on time
-    }
-    else {
-      srand(rng_seed);  //use fixed seed for reproducibility
-    }
-    seeded = true;
-  }
-  
   do {
-    rand1 = rand();
-    rand2 = rand();
-    x = 2.0*rand1/RAND_MAX - 1;
-    y = 2.0*rand2/RAND_MAX - 1;
+    x = 2.0*rng.Uniform() - 1;
+    y = 2.0*rng.Uniform() - 1;
     r = x*x + y*y;
-    //    std::cout << rand1/RAND_MAX << "  " << rand2/RAND_MAX  << std::endl;
   } while (r == 0.0 || r > 1.0);
   
   double d = std::sqrt(-2.0*log(r)/r);
-  double n1 = x*d;
-  n2 = y*d;
-  
-  /*
-  if (!n2_cached) {
-    n2_cached = 1;
-    return n1*sigma + mean;
+  return x*d*sigma + mean;
+}
+
+// Both values of each polar Box-Muller pair are used
+void RNG_NormalDist(double mean, double sigma, RNGStream& rng, double* out,
+                    int n) {
+  if (sigma == 0) {
+    for (int i = 0; i < n; i++) {
+      out[i] = mean;
+    }
+    return;
   }
-  else {
-    n2_cached = 0 ;
-    return n2*sigma + mean;
+  int i = 0;
+  while (i < n) {
+    double x = 2.0*rng.Uniform() - 1;
+    double y = 2.0*rng.Uniform() - 1;
+    double r = x*x + y*y;
+    if (r == 0.0 || r > 1.0) {
+      continue;
+    }
+    double d = std::sqrt(-2.0*log(r)/r);
+    out[i++] = x*d*sigma + mean;
+    if (i < n) {
+      out[i++] = y*d*sigma + mean;
+    }
   }
-  */
-  //  std::cout << "NormalDist: " << n1*sigma + mean  << std::endl;
-  return n1*sigma + mean;
-
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -149,91 +190,159 @@ double RNG_NormalDist(double mean, double sigma, int rng_seed) {
 // (ie. integer betweeen 1 and 5)
 
 double RNG_Integer(double min, double max, int rng_seed) {
+  return RNG_Integer(min, max, SharedStream(rng_seed));
+}
 
-  if (!seeded) {
-    if (rng_seed == -1) {
-      srand(time(0)); // if seeding on time
-    }
-    else {
-      srand(rng_seed);  //use fixed seed for reproducibility
-    }
-    seeded = true;
-  }
-
-  int tRan = min + (rand()*(1.0/(RAND_MAX+1.0))) * max;
+double RNG_Integer(double min, double max, RNGStream& rng) {
+  int tRan = min + rng.Uniform() * max;
 
   return tRan;
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Successes are found by skipping the geometric runs of failures between
+// them, which takes about n*min(prob, 1-prob) draws
+int RNG_Binomial(int n, double prob, RNGStream& rng) {
+  if ((n <= 0) || (prob <= 0)) {
+    return 0;
+  }
+  if (prob >= 1) {
+    return n;
+  }
+  bool count_failures = prob > 0.5;
+  double p = count_failures ? 1 - prob : prob;
+  int k = 0;
+  long trial = RNG_Geometric(p, rng);
+  while (trial < n) {
+    k++;
+    trial += 1 + RNG_Geometric(p, rng);
+  }
+  return count_failures ? n - k : k;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Inverts the geometric distribution function for one uniform draw
+int RNG_Geometric(double prob, RNGStream& rng) {
+  if (prob <= 0) {
+    return -1;
+  }
+  if (prob >= 1) {
+    return 0;
+  }
+  double k = std::floor(std::log1p(-rng.Uniform()) / std::log1p(-prob));
+  if (k >= std::numeric_limits<int>::max()) {
+    return std::numeric_limits<int>::max();
+  }
+  return static_cast<int>(k);
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 // For various types of x_val varying curves, calculate y for some x
 // Constants = [y_int, (slope or y_final), (t_change)]
-  double CalcYVal(std::string function, std::vector<double> constants,
-		  double x_val) {
+TimeCurve::TimeCurve() : type_(CONSTANT) {
+  std::fill(c_, c_ + 5, 0.0);
+}
 
-    double curr_y;
-    
-    if (function == "Constant" || function == "constant"){
-      if (constants.size() < 1) {
-	throw "incorrect number of equation parameters";
-      } else {
-	curr_y = constants[0];
+TimeCurve::TimeCurve(const std::string& function,
+                     const std::vector<double>& constants) {
+  std::fill(c_, c_ + 5, 0.0);
+  if (function == "Constant" || function == "constant") {
+    if (constants.size() < 1) {
+      throw "incorrect number of equation parameters";
+    }
+    type_ = CONSTANT;
+    c_[0] = constants[0];
+  } else if (function == "Linear" || function == "linear") {
+    if (constants.size() < 2) {
+      throw "incorrect number of equation parameters";
+    }
+    type_ = LINEAR;
+    c_[0] = constants[0];
+    c_[1] = constants[1];
+  } else if (function == "Power" || function == "power") {
+    // If powerlaw has only one constant, then that is the power (A)
+    // Bx^A  and B is assumed to be 1.
+    if (constants.size() < 1) {
+      throw "incorrect number of equation parameters";
+    }
+    type_ = POWER;
+    c_[0] = constants[0];
+    c_[1] = (constants.size() == 2) ? constants[1] : 1;
+  } else if (function == "Bounded_Power" || function == "bounded_power") {
+    // Must be defined with all vals below
+    // (Bx^A)+C, [D,E]
+    // Where D is lower bound and E is upper bound. y for any x vals < D is
+    // set to zero, y for any x vals > E is set to E
+    if (constants.size() != 5) {
+      throw "incorrect number of equation parameters";
+    }
+    type_ = BOUNDED_POWER;
+    std::copy(constants.begin(), constants.end(), c_);
+  } else if (function == "Step" || function == "step") {
+    if (constants.size() < 3) {
+      throw "incorrect number of equation parameters";
+    }
+    type_ = STEP;
+    std::copy(constants.begin(), constants.begin() + 3, c_);
+  } else {
+    throw "Function choices are constant, linear, step, power";
+  }
+}
+
+double TimeCurve::Evaluate(double x_val) const {
+  switch (type_) {
+    case LINEAR:
+      return c_[0] + c_[1] * x_val;
+    case POWER:
+      return c_[1] * pow(x_val, c_[0]);
+    case BOUNDED_POWER:
+      if (x_val < c_[3]) {
+        return 0;
+      } else if (x_val > c_[4]) {
+        return c_[2] + (c_[1] * pow(c_[4], c_[0]));
       }
-    } else if (function == "Linear" || function == "linear"){
-      if (constants.size() < 2) {
-	throw "incorrect number of equation parameters";
-      } else {
-	curr_y = constants[0] + constants[1]*x_val;
+      return c_[2] + (c_[1] * pow(x_val, c_[0]));
+    case STEP:
+      return (x_val < c_[2]) ? c_[0] : c_[1];
+    default:
+      return c_[0];
+  }
+}
+
+// A step changes from y_int to y_final at t_change (x >= t_change)
+double TimeCurve::NextChange(double x_val) const {
+  if ((type_ == STEP) && (x_val < c_[2])) {
+    return c_[2];
+  }
+  return HUGE_VAL;
+}
+
+// The type is resolved once for the whole batch
+void TimeCurve::Evaluate(const double* x_vals, double* y_vals, int n) const {
+  switch (type_) {
+    case CONSTANT:
+      std::fill(y_vals, y_vals + n, c_[0]);
+      break;
+    case LINEAR:
+      for (int i = 0; i < n; i++) {
+        y_vals[i] = c_[0] + c_[1] * x_vals[i];
       }
-    } else if (function == "Power" || function == "power"){
-      // If powerlaw has only one constant, then that is the power (A)
-      // Bx^A  and B is assumed to be 1.
-      double c_b = 1;
-      if (constants.size() < 1) {
-	throw "incorrect number of equation parameters";
-      } else if (constants.size() == 2) {
-	c_b = constants[1];
-      } 
-      curr_y = c_b*(pow( x_val, constants[0]));
-    } else if (function == "Bounded_Power" || function == "bounded_power"){
-      // Must be defined with all vals below
-      // (Bx^A)+C, [D,E]
-      // Where D is lower bound and E is upper bound. y for any x vals < D is
-      // set to zero, y for any x vals > E is set to E
-      if (constants.size() != 5) {
-	throw "incorrect number of equation parameters";
-      } else {
-	double c_b = constants[1];
-	double c_a = constants[0];
-	double c_c = constants[2];
-	double c_d = constants[3];
-	double c_e = constants[4];
-	if (x_val < c_d){
-	  curr_y = 0;
-	}
-	else if (x_val > c_e) {
-	  curr_y = c_c + (c_b*(pow(c_e, c_a)));
-	}
-	else {
-	  curr_y = c_c + (c_b*(pow(x_val, c_a)));
-	}
+      break;
+    case STEP:
+      for (int i = 0; i < n; i++) {
+        y_vals[i] = (x_vals[i] < c_[2]) ? c_[0] : c_[1];
       }
-    } else if (function == "Step" || function == "step"){
-      if (constants.size() < 3) {
-	throw "incorrect number of equation parameters";
-      } else {
-	if (x_val < constants[2]){
-	  curr_y = constants[0];
-	}
-	else {
-	  curr_y = constants[1];
-	}
+      break;
+    default:
+      for (int i = 0; i < n; i++) {
+        y_vals[i] = Evaluate(x_vals[i]);
       }
-    } else {
-      throw "Function choices are constant, linear, step, power";
-    }
-  
-  return curr_y;
+  }
+}
+
+double CalcYVal(const std::string& function,
+                const std::vector<double>& constants, double x_val) {
+  return TimeCurve(function, constants).Evaluate(x_val);
 }
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 // Determines probability of an event at a single timestep given the
@@ -245,6 +354,40 @@ double ProbPerTime(double xval, double n_timesteps){
   return 1 - (pow((1.0 - xval), (1.0/n_timesteps)));
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+DecisionSchedule::DecisionSchedule()
+    : next_decision_(0), next_success_(0), next_change_(0), version_(-1) {}
+
+bool DecisionSchedule::Due(int time, long version) const {
+  return (time >= next_decision_) || (version != version_);
+}
+
+bool DecisionSchedule::Decide(int time, long version, double likely,
+                              RNGStream& rng) const {
+  if ((time == next_success_) && (time < next_change_) &&
+      (version == version_)) {
+    return true;
+  }
+  return XLikely(likely, rng);
+}
+
+// The draw is discarded at the next change point, which is exact because
+// the geometric distribution is memoryless.
+void DecisionSchedule::Schedule(int time, long version, double likely,
+                                bool decision, int next_change, int duration,
+                                RNGStream& rng) {
+  version_ = version;
+  next_success_ = duration;
+  next_change_ = decision ? time + 1 : next_change;
+  if (next_change_ > time + 1) {
+    int n_fail = RNG_Geometric(likely, rng);
+    if ((n_fail >= 0) && (n_fail < duration - time - 1)) {
+      next_success_ = time + 1 + n_fail;
+    }
+  }
+  next_decision_ = std::min(next_success_, next_change_);
+}
+
 /*
 double RNG_NormalDist(double mean, double sigma) {
   bool time_seed = 0;
@@ -1,26 +1,66 @@
 #ifndef MBMORE_SRC_BEHAVIOR_FUNCTIONS_H_
 #define MBMORE_SRC_BEHAVIOR_FUNCTIONS_H_
 
+#include <stdint.h>
 #include <string>
 #include <vector>
 
 namespace mbmore {
 
+// Independent stream of random numbers (xoshiro256**). Each agent owns its
+// own stream, seeded from its rng_seed and agent id, so its draws do not
+// depend on what other agents draw or on the order in which agents run.
+// Satisfies UniformRandomBitGenerator so it can drive <random>
+// distributions.
+class RNGStream {
+ public:
+  typedef uint64_t result_type;
+
+  RNGStream();
+  RNGStream(uint64_t seed, uint64_t stream);
+
+  // Restarts the stream for (seed, stream). Different streams with the same
+  // seed are statistically independent.
+  void Seed(uint64_t seed, uint64_t stream);
+
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() { return UINT64_MAX; }
+  result_type operator()();
+
+  // uniform on [0, 1)
+  double Uniform();
+  void Uniform(double* out, int n);
+
+ private:
+  uint64_t s_[4];
+};
+
+// Stream for an agent from its rng_seed input (-1 seeds on the current
+// time and is not reproducible) and its agent id
+RNGStream AgentStream(int rng_seed, int agent_id);
+
 // returns true every X interval (ie every 5th timestep)
 bool EveryXTimestep(int curr_time, int interval);
 
+// The functions taking an int rng_seed draw from one process-wide stream
+// that is seeded on the first call. The RNGStream overloads draw from the
+// caller's own stream.
+
 // randomly returns true with a frequency X
 // (ie returns true ~20 randomly selected timesteps
 // out of 100 when frequency = 5 )
 //bool EveryRandomXTimestep(int frequency);
 
 bool EveryRandomXTimestep(int frequency, int rng_seed);
+bool EveryRandomXTimestep(int frequency, RNGStream& rng);
 
 // returns True with a defined probability
 // (ie. if probability is 0.2 then will return True on average
 // 1 in 5 calls).
 // 
 bool XLikely(double prob, int rng_seed);
+bool XLikely(double prob, RNGStream& rng);
+void XLikely(double prob, RNGStream& rng, bool* out, int n);
 
 // returns a randomly generated number from a
 // normal distribution defined by mean and
@@ -29,20 +69,114 @@ bool XLikely(double prob, int rng_seed);
 
  
 double RNG_NormalDist(double mean, double sigma, int rng_seed);
+double RNG_NormalDist(double mean, double sigma, RNGStream& rng);
+void RNG_NormalDist(double mean, double sigma, RNGStream& rng, double* out,
+		    int n);
 
 // returns a randomly chosen discrete number between min and max
 // (ie. integer betweeen 1 and 5)
 
 double RNG_Integer(double min, double max, int rng_seed);
+double RNG_Integer(double min, double max, RNGStream& rng);
+
+// returns the number of successes in n trials that each succeed with
+// probability prob (the number of n XLikely draws that are true), drawn
+// from a binomial distribution in a single call
+int RNG_Binomial(int n, double prob, RNGStream& rng);
+
+// returns the number of failed trials before the first success in a run of
+// trials that each succeed with probability prob (the number of false
+// XLikely draws before the first true one), or -1 if prob <= 0 (never)
+int RNG_Geometric(double prob, RNGStream& rng);
+
+// Both are computed from rng.Uniform() rather than the <random>
+// distributions, whose algorithms differ between standard libraries, so
+// a seed gives the same draws on every platform.
+
+// Time varying curve of one of the CalcYVal function types, parsed once
+// from the function name and constants so that evaluating it needs no
+// string comparisons or allocation.
+class TimeCurve {
+ public:
+  enum Type { CONSTANT, LINEAR, POWER, BOUNDED_POWER, STEP };
+
+  // y = 0 everywhere
+  TimeCurve();
+
+  // Throws for unknown function names or the wrong number of constants,
+  // as CalcYVal does
+  TimeCurve(const std::string& function, const std::vector<double>& constants);
+
+  Type type() const { return type_; }
+
+  // True for curves that only change value at known points (constant and
+  // step)
+  bool PiecewiseConstant() const {
+    return (type_ == CONSTANT) || (type_ == STEP);
+  }
+
+  // Smallest x greater than x_val at which a piecewise constant curve
+  // changes value, or HUGE_VAL if it does not change after x_val
+  double NextChange(double x_val) const;
+
+  double Evaluate(double x_val) const;
+
+  // y for each of n x values, e.g. a whole simulation's trajectory
+  void Evaluate(const double* x_vals, double* y_vals, int n) const;
+
+ private:
+  Type type_;
+  double c_[5];
+};
 
 // For various types of time varying curves, calculate y for some x
-double CalcYVal(std::string function, std::vector<double> constants,
-		double x_val);
+double CalcYVal(const std::string& function,
+		const std::vector<double>& constants, double x_val);
 
 // Convert probability integrated over n_timesteps (L, N) to a probability (P)
 // at single time, by solving for P:  L = 1 - (1-P)^N 
 double ProbPerTime(double xval, double n_timesteps);
 
+// Event driven schedule of yes/no decisions (one XLikely draw per timestep)
+// whose likelihood only changes at known change points or when version
+// changes (e.g. when the inputs the likelihood depends on are edited).
+// While the likelihood is constant the decisions are independent trials, so
+// the number of failures before the next success is drawn once from the
+// geometric distribution and only the success and the change points need a
+// decision. The decisions have the same distribution as per-timestep draws.
+class DecisionSchedule {
+ public:
+  // Due at any time until the first decision
+  DecisionSchedule();
+
+  // True if a decision is due at time: the sampled success, the next change
+  // point, or anything after version changed since the schedule was drawn
+  bool Due(int time, long version) const;
+
+  // Decision at time with likelihood likely: the sampled success if time is
+  // the success drawn for the current version before the next change point,
+  // otherwise a fresh XLikely draw
+  bool Decide(int time, long version, double likely, RNGStream& rng) const;
+
+  // Draws the schedule after a decision at time. next_change is the first
+  // change point after time (time + 1 if the likelihood may change every
+  // timestep). After a success the next decision is at time + 1. Nothing
+  // is scheduled at or after duration.
+  void Schedule(int time, long version, double likely, bool decision,
+		int next_change, int duration, RNGStream& rng);
+
+  int next_decision() const { return next_decision_; }
+  int next_success() const { return next_success_; }
+  int next_change() const { return next_change_; }
+  long version() const { return version_; }
+
+ private:
+  int next_decision_;
+  int next_success_;
+  int next_change_;
+  long version_;
+};
+
 } // namespace mbmore
 
 #endif  //  MBMORE_SRC_BEHAVIOR_FUNCTIONS_H_
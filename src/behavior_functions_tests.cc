@@ -1,5 +1,9 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <cmath>
+#include <random>
+
 #include "behavior_functions.h"
 
 #include "agent_tests.h"
@@ -249,6 +253,66 @@ TEST(Behavior_Functions_Test, TestCalcYVal) {
 
   }
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Parsed curves match CalcYVal, one x at a time and in batches, and report
+// bad input when they are parsed
+TEST(Behavior_Functions_Test, TestTimeCurve) {
+  const char* functions[] = {"Constant", "linear", "power", "Bounded_Power",
+			     "step"};
+  double c[] = {2, 0.5, 6, 1, 8};
+  std::vector<double> constants(c, c + 5);
+
+  // 2, 2 + 0.5x, 0.5x^2, 6 + 0.5x^2 on [1,8], step from 2 to 0.5 at 6
+  double expected[5][12] = {
+    {2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2},
+    {2, 2.5, 3, 3.5, 4, 4.5, 5, 5.5, 6, 6.5, 7, 7.5},
+    {0, 0.5, 2, 4.5, 8, 12.5, 18, 24.5, 32, 40.5, 50, 60.5},
+    {0, 6.5, 8, 10.5, 14, 18.5, 24, 30.5, 38, 38, 38, 38},
+    {2, 2, 2, 2, 2, 2, 0.5, 0.5, 0.5, 0.5, 0.5, 0.5}};
+
+  std::vector<double> x_vals;
+  for (int t = 0; t < 12; t++) {
+    x_vals.push_back(t);
+  }
+  std::vector<double> y_vals(x_vals.size());
+
+  for (int f = 0; f < 5; f++) {
+    std::vector<double> f_const = constants;
+    if (f == 2) {
+      f_const.resize(2);
+    }
+    TimeCurve curve(functions[f], f_const);
+    curve.Evaluate(&x_vals[0], &y_vals[0], x_vals.size());
+    for (int t = 0; t < x_vals.size(); t++) {
+      EXPECT_DOUBLE_EQ(curve.Evaluate(x_vals[t]), expected[f][t]);
+      EXPECT_DOUBLE_EQ(y_vals[t], expected[f][t]);
+      EXPECT_DOUBLE_EQ(CalcYVal(functions[f], f_const, x_vals[t]),
+		       expected[f][t]);
+    }
+  }
+  EXPECT_EQ(TimeCurve("Bounded_Power", constants).type(),
+	    TimeCurve::BOUNDED_POWER);
+  EXPECT_EQ(TimeCurve().Evaluate(3.0), 0);
+
+  EXPECT_THROW(TimeCurve("bounded_power", std::vector<double>(2, 1.0)),
+	       const char*);
+  EXPECT_THROW(TimeCurve("exponential", constants), const char*);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// A random Step (as in StateInst P_f) has only its two levels until the
+// change time is drawn in the time 0 Tick, and cannot be parsed before then
+TEST(Behavior_Functions_Test, TestRandomStepCurve) {
+  std::vector<double> step_constants;
+  step_constants.push_back(0.2);
+  step_constants.push_back(0.9);
+  EXPECT_THROW(TimeCurve("Step", step_constants), const char*);
+
+  step_constants.push_back(4);
+  TimeCurve step("Step", step_constants);
+  EXPECT_DOUBLE_EQ(step.Evaluate(3), 0.2);
+  EXPECT_DOUBLE_EQ(step.Evaluate(4), 0.9);
+}
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
 
   
@@ -263,4 +327,264 @@ TEST(Behavior_Functions_Test, TestProbPerTime) {
   EXPECT_NEAR(y_val, py_val, tol);
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Agent streams are reproducible, independent of each other (draws on one
+// stream do not change another) and give the same numbers in batch and
+// one at a time
+TEST(Behavior_Functions_Test, TestRNGStream) {
+  RNGStream a = AgentStream(7, 12);
+  RNGStream b = AgentStream(7, 13);
+  RNGStream a_again = AgentStream(7, 12);
+
+  std::vector<double> draws(100);
+  a.Uniform(&draws[0], draws.size());
+  int n_same = 0;
+  for (int i = 0; i < draws.size(); i++) {
+    // interleave draws on another stream
+    double other = b.Uniform();
+    EXPECT_EQ(draws[i], a_again.Uniform());
+    EXPECT_GE(draws[i], 0.0);
+    EXPECT_LT(draws[i], 1.0);
+    if (other == draws[i]) {
+      n_same++;
+    }
+  }
+  EXPECT_EQ(n_same, 0);
+
+  RNGStream c(1, 1);
+  RNGStream c_again(1, 1);
+  std::vector<double> normals(11);
+  RNG_NormalDist(10, 2, c, &normals[0], normals.size());
+  double first = RNG_NormalDist(10, 2, c_again);
+  EXPECT_EQ(normals[0], first);
+
+  bool likely[50];
+  RNGStream d(3, 4);
+  RNGStream d_again(3, 4);
+  XLikely(0.3, d, likely, 50);
+  for (int i = 0; i < 50; i++) {
+    EXPECT_EQ(likely[i], XLikely(0.3, d_again));
+  }
+
+  // usable with the standard distributions
+  RNGStream e(5, 0);
+  std::uniform_int_distribution<int> dist(1, 6);
+  for (int i = 0; i < 100; i++) {
+    int roll = dist(e);
+    EXPECT_GE(roll, 1);
+    EXPECT_LE(roll, 6);
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Binomial draws have the mean and variance of n XLikely draws, stay in
+// range and are reproducible from the seed
+TEST(Behavior_Functions_Test, TestRNGBinomial) {
+  int n = 5000;
+  double prob = 0.2;
+  int n_draws = 2000;
+
+  RNGStream rng(11, 2);
+  double sum = 0;
+  double sum_sq = 0;
+  for (int i = 0; i < n_draws; i++) {
+    int k = RNG_Binomial(n, prob, rng);
+    EXPECT_GE(k, 0);
+    EXPECT_LE(k, n);
+    sum += k;
+    sum_sq += double(k) * k;
+  }
+  double mean = sum / n_draws;
+  double var = sum_sq / n_draws - mean * mean;
+  EXPECT_NEAR(mean, n * prob, 2.0);
+  EXPECT_NEAR(var / (n * prob * (1 - prob)), 1.0, 0.15);
+
+  RNGStream a(7, 1);
+  RNGStream b(7, 1);
+  for (int i = 0; i < 20; i++) {
+    EXPECT_EQ(RNG_Binomial(100, 0.5, a), RNG_Binomial(100, 0.5, b));
+  }
+
+  EXPECT_EQ(RNG_Binomial(10, 0, rng), 0);
+  EXPECT_EQ(RNG_Binomial(10, 1, rng), 10);
+  EXPECT_EQ(RNG_Binomial(0, 0.5, rng), 0);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Geometric draws have the mean number of failures (1-p)/p of a run of
+// XLikely draws, and are reproducible from the seed
+TEST(Behavior_Functions_Test, TestRNGGeometric) {
+  double prob = 0.05;
+  int n_draws = 20000;
+
+  RNGStream rng(3, 4);
+  double sum = 0;
+  for (int i = 0; i < n_draws; i++) {
+    int k = RNG_Geometric(prob, rng);
+    EXPECT_GE(k, 0);
+    sum += k;
+  }
+  EXPECT_NEAR(sum / n_draws, (1 - prob) / prob, 0.5);
+
+  RNGStream a(7, 1);
+  RNGStream b(7, 1);
+  for (int i = 0; i < 20; i++) {
+    EXPECT_EQ(RNG_Geometric(0.3, a), RNG_Geometric(0.3, b));
+  }
+
+  EXPECT_EQ(RNG_Geometric(0, rng), -1);
+  EXPECT_EQ(RNG_Geometric(1, rng), 0);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Geometric and binomial draws only depend on the stream's uniform draws,
+// so a seed gives these values whatever the standard library
+TEST(Behavior_Functions_Test, TestRNGDiscreteSequence) {
+  int geometric[] = {1, 1, 1, 0, 3, 2};
+  int binomial[] = {43, 59, 44, 43, 50, 51};
+  int binomial_high[] = {33, 36, 36, 38, 37, 40};
+  RNGStream a(5, 3);
+  RNGStream b(5, 3);
+  RNGStream c(5, 3);
+  for (int i = 0; i < 6; i++) {
+    EXPECT_EQ(RNG_Geometric(0.2, a), geometric[i]);
+    EXPECT_EQ(RNG_Binomial(1000, 0.05, b), binomial[i]);
+    EXPECT_EQ(RNG_Binomial(40, 0.9, c), binomial_high[i]);
+  }
+
+  // one uniform draw per geometric draw
+  RNGStream u(5, 3);
+  EXPECT_EQ(geometric[0],
+	    int(std::floor(std::log1p(-u.Uniform()) / std::log1p(-0.2))));
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Constant and step curves report where they next change value
+TEST(Behavior_Functions_Test, TestTimeCurveChanges) {
+  std::vector<double> step_constants;
+  step_constants.push_back(3);
+  step_constants.push_back(6);
+  step_constants.push_back(10);
+  TimeCurve step("Step", step_constants);
+  EXPECT_TRUE(step.PiecewiseConstant());
+  EXPECT_EQ(step.NextChange(0), 10);
+  EXPECT_EQ(step.NextChange(9.5), 10);
+  EXPECT_EQ(step.NextChange(10), HUGE_VAL);
+
+  TimeCurve constant("Constant", std::vector<double>(1, 4));
+  EXPECT_TRUE(constant.PiecewiseConstant());
+  EXPECT_EQ(constant.NextChange(0), HUGE_VAL);
+
+  TimeCurve linear("Linear", std::vector<double>(2, 1));
+  EXPECT_FALSE(linear.PiecewiseConstant());
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Decisions are due at the sampled success, change points and version
+// changes only, and the sampled success is only kept until either of the
+// others happens
+TEST(Behavior_Functions_Test, TestDecisionSchedule) {
+  int duration = 100;
+  RNGStream rng(5, 2);
+
+  DecisionSchedule sched;
+  EXPECT_TRUE(sched.Due(0, 0));
+
+  // no change point: due only at the sampled success
+  sched.Schedule(0, 0, 0.3, false, duration, duration, rng);
+  int t_success = sched.next_success();
+  ASSERT_GT(t_success, 0);
+  ASSERT_LT(t_success, duration);
+  EXPECT_EQ(sched.next_decision(), t_success);
+  for (int t = 1; t < t_success; t++) {
+    EXPECT_FALSE(sched.Due(t, 0));
+  }
+  EXPECT_TRUE(sched.Due(t_success, 0));
+  // the sampled success is forced, whatever the likelihood now
+  EXPECT_TRUE(sched.Decide(t_success, 0, 0.0, rng));
+
+  // a version change makes the state due and discards the sampled success
+  EXPECT_TRUE(sched.Due(1, 1));
+  EXPECT_FALSE(sched.Decide(t_success, 1, 0.0, rng));
+
+  // a change point before the sampled success discards it
+  sched.Schedule(0, 0, 0.01, false, 5, duration, rng);
+  EXPECT_EQ(sched.next_change(), 5);
+  EXPECT_EQ(sched.next_decision(), std::min(sched.next_success(), 5));
+  EXPECT_TRUE(sched.Due(5, 0));
+  EXPECT_FALSE(sched.Decide(5, 0, 0.0, rng));
+
+  // after a success the next phase is decided on the next timestep
+  sched.Schedule(3, 0, 0.5, true, duration, duration, rng);
+  EXPECT_EQ(sched.next_decision(), 4);
+  EXPECT_FALSE(sched.Decide(4, 0, 0.0, rng));
+
+  // likelihood that may change every timestep: no draw is made
+  sched.Schedule(3, 0, 0.5, false, 4, duration, rng);
+  EXPECT_EQ(sched.next_decision(), 4);
+  EXPECT_FALSE(sched.Decide(4, 0, 0.0, rng));
+
+  // never succeeds: nothing is due before the end
+  sched.Schedule(0, 0, 0.0, false, duration, duration, rng);
+  EXPECT_EQ(sched.next_success(), duration);
+  EXPECT_FALSE(sched.Due(duration - 1, 0));
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// The first success of the event driven schedule has the same distribution
+// as drawing XLikely every timestep, here with a likelihood that steps up
+// at t_change
+TEST(Behavior_Functions_Test, TestDecisionScheduleStatistics) {
+  int duration = 100;
+  int t_change = 20;
+  double p_before = 0.05;
+  double p_after = 0.2;
+  int n_runs = 20000;
+
+  RNGStream step_rng(11, 1);
+  RNGStream event_rng(11, 2);
+  double step_sum = 0;
+  double event_sum = 0;
+  int step_early = 0;
+  int event_early = 0;
+  int n_event_decisions = 0;
+  for (int run = 0; run < n_runs; run++) {
+    int t_first = duration;
+    for (int t = 0; t < duration; t++) {
+      if (XLikely((t < t_change) ? p_before : p_after, step_rng)) {
+	t_first = t;
+	break;
+      }
+    }
+    step_sum += t_first;
+    step_early += (t_first < t_change);
+
+    t_first = duration;
+    DecisionSchedule sched;
+    for (int t = 0; t < duration; t++) {
+      if (!sched.Due(t, 0)) {
+	continue;
+      }
+      n_event_decisions++;
+      double likely = (t < t_change) ? p_before : p_after;
+      if (sched.Decide(t, 0, likely, event_rng)) {
+	t_first = t;
+	break;
+      }
+      int next_change = (t < t_change) ? t_change : duration;
+      sched.Schedule(t, 0, likely, false, next_change, duration, event_rng);
+    }
+    event_sum += t_first;
+    event_early += (t_first < t_change);
+  }
+
+  // the mean first success is about 13.6 (standard deviation about 9.4)
+  EXPECT_NEAR(event_sum / n_runs, step_sum / n_runs, 0.5);
+  double p_early = 1 - pow(1 - p_before, t_change);
+  EXPECT_NEAR(double(step_early) / n_runs, p_early, 0.02);
+  EXPECT_NEAR(double(event_early) / n_runs, p_early, 0.02);
+  // at most the first timestep, the change point and the success
+  EXPECT_LE(n_event_decisions, 3 * n_runs);
+}
+
 } // namespace mbmore
\ No newline at end of file
@@ -0,0 +1,135 @@
+#include "cascade_cache.h"
+
+#include <cstring>
+#include <stdint.h>
+
+#include "enrich_functions.h"
+
+namespace mbmore {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool CascadeDesignKey::operator==(const CascadeDesignKey& other) const {
+  return v_a == other.v_a && height == other.height &&
+         diameter == other.diameter && machine_feed == other.machine_feed &&
+         temp == other.temp && feed_assay == other.feed_assay &&
+         product_assay == other.product_assay &&
+         tails_assay == other.tails_assay &&
+         max_centrifuges == other.max_centrifuges && cut == other.cut &&
+         eff == other.eff && M == other.M && dM == other.dM &&
+         x == other.x && flow_internal == other.flow_internal;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// FNV-1a over the bit patterns of the inputs. Values that compare equal must
+// hash equally, so -0.0 is folded onto 0.0 first.
+namespace {
+void HashValue(uint64_t* h, double val) {
+  if (val == 0) {
+    val = 0;
+  }
+  unsigned char bytes[sizeof(double)];
+  std::memcpy(bytes, &val, sizeof(double));
+  for (std::size_t i = 0; i < sizeof(double); i++) {
+    *h ^= bytes[i];
+    *h *= 1099511628211ULL;
+  }
+}
+}  // namespace
+
+std::size_t CascadeDesignKeyHash::operator()(
+    const CascadeDesignKey& key) const {
+  uint64_t h = 14695981039346656037ULL;
+  HashValue(&h, key.v_a);
+  HashValue(&h, key.height);
+  HashValue(&h, key.diameter);
+  HashValue(&h, key.machine_feed);
+  HashValue(&h, key.temp);
+  HashValue(&h, key.feed_assay);
+  HashValue(&h, key.product_assay);
+  HashValue(&h, key.tails_assay);
+  HashValue(&h, static_cast<double>(key.max_centrifuges));
+  HashValue(&h, key.cut);
+  HashValue(&h, key.eff);
+  HashValue(&h, key.M);
+  HashValue(&h, key.dM);
+  HashValue(&h, key.x);
+  HashValue(&h, key.flow_internal);
+  return static_cast<std::size_t>(h);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+CascadeDesign CalcCascadeDesign(const CascadeDesignKey& key) {
+  CascadeDesign design;
+
+  // Calculate ideal machine performance
+  design.delU = CalcDelU(key.v_a, key.height, key.diameter, key.machine_feed,
+                         key.temp, key.cut, key.eff, key.M, key.dM, key.x,
+                         key.flow_internal);
+  design.alpha = AlphaBySwu(design.delU, key.machine_feed, key.cut, key.M);
+
+  // Design ideal cascade based on target product assay and available machines
+  design.n_stages = FindNStages(design.alpha, key.feed_assay,
+                                key.product_assay, key.tails_assay);
+  CascadeSize size = SizeCascade(design.alpha, design.delU, key.cut,
+                                 key.max_centrifuges, design.n_stages);
+  design.n_machines = size.n_machines;
+  design.feed_flow = size.feed_flow;
+  return design;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+CascadeDesignCache::CascadeDesignCache() : hits_(0), misses_(0) {}
+
+CascadeDesignCache& CascadeDesignCache::Instance() {
+  static CascadeDesignCache cache;
+  return cache;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// The design is computed outside of the lock so that concurrent misses on
+// different keys do not serialize. If two threads miss on the same key they
+// compute identical designs and the first one stored is kept.
+CascadeDesign CascadeDesignCache::Get(const CascadeDesignKey& key) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::unordered_map<CascadeDesignKey, CascadeDesign,
+                       CascadeDesignKeyHash>::const_iterator it =
+        designs_.find(key);
+    if (it != designs_.end()) {
+      hits_++;
+      return it->second;
+    }
+    misses_++;
+  }
+
+  CascadeDesign design = CalcCascadeDesign(key);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  designs_.insert(std::make_pair(key, design));
+  return design;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+long CascadeDesignCache::hits() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return hits_;
+}
+
+long CascadeDesignCache::misses() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return misses_;
+}
+
+std::size_t CascadeDesignCache::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return designs_.size();
+}
+
+void CascadeDesignCache::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  designs_.clear();
+  hits_ = 0;
+  misses_ = 0;
+}
+
+} // namespace mbmore
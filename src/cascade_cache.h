@@ -0,0 +1,88 @@
+#ifndef MBMORE_SRC_CASCADE_CACHE_H_
+#define MBMORE_SRC_CASCADE_CACHE_H_
+
+#include <cstddef>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace mbmore {
+
+  // All of the inputs that determine a cascade design. Machine feed is in
+  // kg/sec (the units used by CalcDelU).
+  struct CascadeDesignKey {
+    double v_a;
+    double height;
+    double diameter;
+    double machine_feed;
+    double temp;
+    double feed_assay;
+    double product_assay;
+    double tails_assay;
+    int max_centrifuges;
+
+    // Fixed model assumptions (see CascadeEnrich)
+    double cut;
+    double eff;
+    double M;
+    double dM;
+    double x;
+    double flow_internal;
+
+    bool operator==(const CascadeDesignKey& other) const;
+  };
+
+  // Canonical hash of a design key (-0.0 and 0.0 hash identically)
+  struct CascadeDesignKeyHash {
+    std::size_t operator()(const CascadeDesignKey& key) const;
+  };
+
+  // Cascade design: machine performance, stages and size
+  struct CascadeDesign {
+    int n_machines;                // machines used by the cascade
+    double feed_flow;              // cascade feed (kg/sec)
+    std::pair<int, int> n_stages;  // (enriching, stripping)
+    double delU;                   // separation potential of one machine
+    double alpha;                  // separation factor of one machine
+  };
+
+  // Runs CalcDelU, AlphaBySwu, FindNStages and DesignCascade for the key
+  CascadeDesign CalcCascadeDesign(const CascadeDesignKey& key);
+
+  /// @class CascadeDesignCache
+  ///
+  /// @brief Process-wide, thread-safe memo of cascade designs so that many
+  /// CascadeEnrich facilities built from the same machine and assay
+  /// parameters only pay the design cost once.
+  class CascadeDesignCache {
+   public:
+    // The single cache shared by all facilities in the process
+    static CascadeDesignCache& Instance();
+
+    // Returns the stored design for key, computing and storing it on a miss.
+    // Designs that cannot be built (ValueError) are not stored.
+    CascadeDesign Get(const CascadeDesignKey& key);
+
+    // Number of lookups answered from / added to the cache
+    long hits() const;
+    long misses() const;
+
+    // Number of stored designs
+    std::size_t size() const;
+
+    // Removes all designs and resets the counters
+    void Clear();
+
+   private:
+    CascadeDesignCache();
+
+    mutable std::mutex mutex_;
+    std::unordered_map<CascadeDesignKey, CascadeDesign,
+                       CascadeDesignKeyHash> designs_;
+    long hits_;
+    long misses_;
+  };
+
+} // namespace mbmore
+
+#endif  //  MBMORE_SRC_CASCADE_CACHE_H_
@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+
+#include "cascade_cache.h"
+#include "enrich_functions.h"
+
+#include "agent_tests.h"
+#include "context.h"
+#include "facility_tests.h"
+
+namespace mbmore {
+
+  namespace cascadecachetests {
+    // Centrifuge and cascade params from enrich_functions_tests
+    CascadeDesignKey TestKey() {
+      CascadeDesignKey key;
+      key.v_a = 485;
+      key.height = 0.5;
+      key.diameter = 0.15;
+      key.machine_feed = 15 * 60 * 60 / ((1e3) * 60 * 60 * 1000.0);
+      key.temp = 320.0;
+      key.feed_assay = 0.0071;
+      key.product_assay = 0.035;
+      key.tails_assay = 0.001;
+      key.max_centrifuges = 5000;
+      key.cut = 0.5;
+      key.eff = 1.0;
+      key.M = 0.352;
+      key.dM = 0.003;
+      key.x = 1000;
+      key.flow_internal = 2.0;
+      return key;
+    }
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Designs from the cache match the direct calculation and repeated lookups
+// are counted as hits
+TEST(Cascade_Cache_Test, HitsAndMisses) {
+  CascadeDesignCache& cache = CascadeDesignCache::Instance();
+  cache.Clear();
+
+  CascadeDesignKey key = TestKey();
+  CascadeDesign direct = CalcCascadeDesign(key);
+
+  CascadeDesign first = cache.Get(key);
+  EXPECT_EQ(cache.misses(), 1);
+  EXPECT_EQ(cache.hits(), 0);
+
+  CascadeDesign second = cache.Get(key);
+  EXPECT_EQ(cache.misses(), 1);
+  EXPECT_EQ(cache.hits(), 1);
+  EXPECT_EQ(cache.size(), 1);
+
+  EXPECT_EQ(direct.n_machines, first.n_machines);
+  EXPECT_EQ(direct.n_machines, second.n_machines);
+  EXPECT_DOUBLE_EQ(direct.feed_flow, second.feed_flow);
+  EXPECT_EQ(direct.n_stages, second.n_stages);
+  EXPECT_DOUBLE_EQ(direct.delU, second.delU);
+  EXPECT_DOUBLE_EQ(direct.alpha, second.alpha);
+
+  // any change to the inputs is a different design
+  key.max_centrifuges = 6000;
+  CascadeDesign bigger = cache.Get(key);
+  EXPECT_EQ(cache.misses(), 2);
+  EXPECT_EQ(cache.size(), 2);
+  EXPECT_GT(bigger.n_machines, first.n_machines);
+
+  cache.Clear();
+  EXPECT_EQ(cache.size(), 0);
+  EXPECT_EQ(cache.hits(), 0);
+  EXPECT_EQ(cache.misses(), 0);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Keys that compare equal hash equally
+TEST(Cascade_Cache_Test, CanonicalHash) {
+  CascadeDesignKey key_a = TestKey();
+  CascadeDesignKey key_b = TestKey();
+  key_a.temp = 0.0;
+  key_b.temp = -0.0;
+  CascadeDesignKeyHash hasher;
+  EXPECT_TRUE(key_a == key_b);
+  EXPECT_EQ(hasher(key_a), hasher(key_b));
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Designs that cannot be built are reported every time and not stored
+TEST(Cascade_Cache_Test, FailedDesign) {
+  CascadeDesignCache& cache = CascadeDesignCache::Instance();
+  cache.Clear();
+
+  CascadeDesignKey key = TestKey();
+  key.max_centrifuges = 1;
+  EXPECT_THROW(cache.Get(key), cyclus::ValueError);
+  EXPECT_THROW(cache.Get(key), cyclus::ValueError);
+  EXPECT_EQ(cache.size(), 0);
+  EXPECT_EQ(cache.misses(), 2);
+  cache.Clear();
+}
+
+  } // namespace cascadecachetests
+} // namespace mbmore
@@ -0,0 +1,308 @@
+// Standalone parameter sweep over cascade designs.
+//
+// Usage: mbmore_cascade_sweep <grid spec> [-o out.csv] [-j n_threads]
+//
+// The grid spec has one parameter per line, either as a list of values
+//     centrifuge_velocity 485 500 550
+// or as an evenly spaced range (start:stop:count)
+//     machine_feed 10:20:11
+// Blank lines and lines starting with # are ignored. Parameters that are not
+// given keep the CascadeEnrich defaults. Units match the CascadeEnrich input
+// file (m/s, m, K, mg/s). Every combination of values is designed with
+//     CalcDelU -> AlphaBySwu -> FindNStages -> DesignCascade
+// and one CSV row is written per point, in grid order (last parameter
+// varying fastest) whatever the number of threads.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "enrich_functions.h"
+
+namespace mbmore {
+namespace {
+
+// Fixed assumptions for a cascade separating U235 from U238 in UF6 gas
+// (same as CascadeEnrich)
+const double M = 0.352;
+const double dM = 0.003;
+const double x = 1000;
+const double flow_internal = 2.0;
+const double eff = 1.0;
+const double cut = 0.5;
+const double secpermonth = 60 * 60 * 24 * (365.25 / 12);
+
+const char* param_names[] = {"centrifuge_velocity", "height", "diameter",
+                             "temp", "machine_feed", "feed_assay",
+                             "product_assay", "tails_assay",
+                             "max_centrifuges"};
+const int n_params = sizeof(param_names) / sizeof(param_names[0]);
+const double param_defaults[] = {485.0, 0.5, 0.15, 320.0, 15.0,
+                                 0.0071, 0.035, 0.003, 1000};
+
+struct SweepResult {
+  bool ok;
+  double delU;
+  double alpha;
+  std::pair<int, int> n_stages;
+  int n_machines;
+  double feed_flow;
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+std::vector<std::vector<double> > ReadGridSpec(const std::string& path) {
+  std::vector<std::vector<double> > axes(n_params);
+  for (int p = 0; p < n_params; p++) {
+    axes[p].push_back(param_defaults[p]);
+  }
+
+  std::ifstream in(path.c_str());
+  if (!in) {
+    throw std::runtime_error("cannot open grid spec " + path);
+  }
+  std::string line;
+  while (std::getline(in, line)) {
+    std::istringstream words(line);
+    std::string name;
+    if (!(words >> name) || name[0] == '#') {
+      continue;
+    }
+    int p = 0;
+    while ((p < n_params) && (name != param_names[p])) {
+      p++;
+    }
+    if (p == n_params) {
+      throw std::runtime_error("unknown sweep parameter " + name);
+    }
+
+    std::vector<double> values;
+    std::string word;
+    while (words >> word) {
+      double start, stop;
+      int count;
+      if (std::sscanf(word.c_str(), "%lf:%lf:%d", &start, &stop, &count) ==
+          3) {
+        for (int i = 0; i < count; i++) {
+          values.push_back(
+              (count == 1) ? start : start + (stop - start) * i / (count - 1));
+        }
+      } else {
+        values.push_back(std::atof(word.c_str()));
+      }
+    }
+    if (values.empty()) {
+      throw std::runtime_error("no values given for " + name);
+    }
+    axes[p] = values;
+  }
+  return axes;
+}
+
+// Parameter values of grid point i (last axis varies fastest)
+std::vector<double> GridPoint(const std::vector<std::vector<double> >& axes,
+                              long i) {
+  std::vector<double> point(n_params);
+  for (int p = n_params - 1; p >= 0; p--) {
+    point[p] = axes[p][i % axes[p].size()];
+    i /= axes[p].size();
+  }
+  return point;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+SweepResult DesignPoint(const std::vector<double>& point) {
+  SweepResult result;
+  result.ok = false;
+  double machine_feed = point[4] / 1e6;  // mg/s -> kg/s
+  try {
+    result.delU = CalcDelU(point[0], point[1], point[2], machine_feed,
+                           point[3], cut, eff, M, dM, x, flow_internal);
+    result.alpha = AlphaBySwu(result.delU, machine_feed, cut, M);
+    result.n_stages = FindNStages(result.alpha, point[5], point[6], point[7]);
+    std::pair<int, double> design =
+        DesignCascade(0, result.alpha, result.delU, cut,
+                      static_cast<int>(point[8]), result.n_stages);
+    result.n_machines = design.first;
+    result.feed_flow = design.second;
+    result.ok = true;
+  } catch (std::exception& e) {
+    // infeasible design or failed solve, reported as a failed row. Nothing
+    // may escape here since this runs on the pool's worker threads.
+  }
+  return result;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Work stealing pool. The grid is split into one contiguous block of point
+// indices per worker. Workers take points in order from the front of their
+// own deque and, once it is empty, steal from the back of the others (so
+// the lowest indices, which the writer needs first, stay with their owner).
+// Finished points are flagged so the writer can stream them in order.
+class SweepPool {
+ public:
+  SweepPool(const std::vector<std::vector<double> >& axes, long n_points,
+            int n_threads)
+      : axes_(axes),
+        results_(n_points),
+        done_(n_points, false),
+        queues_(n_threads),
+        locks_(n_threads) {
+    for (int t = 0; t < n_threads; t++) {
+      long begin = n_points * t / n_threads;
+      long end = n_points * (t + 1) / n_threads;
+      for (long i = begin; i < end; i++) {
+        queues_[t].push_back(i);
+      }
+    }
+    for (int t = 0; t < n_threads; t++) {
+      workers_.push_back(std::thread(&SweepPool::Work, this, t));
+    }
+  }
+
+  ~SweepPool() {
+    for (size_t t = 0; t < workers_.size(); t++) {
+      workers_[t].join();
+    }
+  }
+
+  // Blocks until point i has been designed
+  const SweepResult& Wait(long i) {
+    std::unique_lock<std::mutex> lock(done_mutex_);
+    while (!done_[i]) {
+      done_cv_.wait(lock);
+    }
+    return results_[i];
+  }
+
+ private:
+  bool Take(int t, long* i) {
+    int n_threads = queues_.size();
+    {
+      std::lock_guard<std::mutex> lock(locks_[t]);
+      if (!queues_[t].empty()) {
+        *i = queues_[t].front();
+        queues_[t].pop_front();
+        return true;
+      }
+    }
+    for (int k = 1; k < n_threads; k++) {
+      int victim = (t + k) % n_threads;
+      std::lock_guard<std::mutex> lock(locks_[victim]);
+      if (!queues_[victim].empty()) {
+        *i = queues_[victim].back();
+        queues_[victim].pop_back();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void Work(int t) {
+    long i;
+    while (Take(t, &i)) {
+      results_[i] = DesignPoint(GridPoint(axes_, i));
+      std::lock_guard<std::mutex> lock(done_mutex_);
+      done_[i] = true;
+      done_cv_.notify_all();
+    }
+  }
+
+  const std::vector<std::vector<double> >& axes_;
+  std::vector<SweepResult> results_;
+  std::vector<bool> done_;
+  std::mutex done_mutex_;
+  std::condition_variable done_cv_;
+  std::vector<std::deque<long> > queues_;
+  std::vector<std::mutex> locks_;
+  std::vector<std::thread> workers_;
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void WriteHeader(std::ostream& out) {
+  for (int p = 0; p < n_params; p++) {
+    out << param_names[p] << ",";
+  }
+  out << "ok,delU,alpha,n_enrich_stages,n_strip_stages,n_machines,"
+      << "feed_flow_kg_per_mon,swu_per_mon\n";
+}
+
+void WriteRow(std::ostream& out, const std::vector<double>& point,
+              const SweepResult& result) {
+  for (int p = 0; p < n_params; p++) {
+    out << point[p] << ",";
+  }
+  if (!result.ok) {
+    out << "0,,,,,,,\n";
+    return;
+  }
+  out << "1," << result.delU << "," << result.alpha << ","
+      << result.n_stages.first << "," << result.n_stages.second << ","
+      << result.n_machines << "," << result.feed_flow * secpermonth << ","
+      << result.n_machines * result.delU * secpermonth << "\n";
+}
+
+}  // namespace
+}  // namespace mbmore
+
+int main(int argc, char* argv[]) {
+  using namespace mbmore;
+
+  std::string spec;
+  std::string out_path;
+  int n_threads = std::thread::hardware_concurrency();
+  for (int a = 1; a < argc; a++) {
+    if ((std::strcmp(argv[a], "-o") == 0) && (a + 1 < argc)) {
+      out_path = argv[++a];
+    } else if ((std::strcmp(argv[a], "-j") == 0) && (a + 1 < argc)) {
+      n_threads = std::atoi(argv[++a]);
+    } else {
+      spec = argv[a];
+    }
+  }
+  if (spec.empty()) {
+    std::cerr << "usage: " << argv[0]
+              << " <grid spec> [-o out.csv] [-j n_threads]\n";
+    return 1;
+  }
+  n_threads = std::max(n_threads, 1);
+
+  try {
+    std::vector<std::vector<double> > axes = ReadGridSpec(spec);
+    long n_points = 1;
+    for (int p = 0; p < n_params; p++) {
+      n_points *= axes[p].size();
+    }
+
+    std::ofstream file;
+    if (!out_path.empty()) {
+      file.open(out_path.c_str());
+      if (!file) {
+        throw std::runtime_error("cannot open output " + out_path);
+      }
+    }
+    std::ostream& out = out_path.empty() ? std::cout : file;
+    out << std::setprecision(12);
+
+    WriteHeader(out);
+    SweepPool pool(axes, n_points, std::min<long>(n_threads, n_points));
+    for (long i = 0; i < n_points; i++) {
+      WriteRow(out, GridPoint(axes, i), pool.Wait(i));
+    }
+  } catch (std::exception& e) {
+    std::cerr << argv[0] << ": " << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,30 @@
+# Checks that mbmore_cascade_sweep writes the same CSV whatever the number
+# of threads. Run with
+#   cmake -DSWEEP=<mbmore_cascade_sweep> -DOUT_DIR=<dir> -P cascade_sweep_test.cmake
+# The grid includes edge points (no centrifuges, tails above the feed
+# assay) so that empty and failed designs are compared as well.
+
+SET(grid ${OUT_DIR}/cascade_sweep_test_grid.txt)
+FILE(WRITE ${grid}
+  "centrifuge_velocity 400:600:5\n"
+  "machine_feed 10 15 20\n"
+  "tails_assay 0.002 0.003 0.008\n"
+  "max_centrifuges 0 100 1000\n")
+
+FOREACH(n_threads 1 4)
+  EXECUTE_PROCESS(
+    COMMAND ${SWEEP} ${grid} -o ${OUT_DIR}/cascade_sweep_j${n_threads}.csv
+      -j ${n_threads}
+    RESULT_VARIABLE result)
+  IF(NOT result EQUAL 0)
+    MESSAGE(FATAL_ERROR "sweep with -j ${n_threads} failed: ${result}")
+  ENDIF()
+ENDFOREACH()
+
+EXECUTE_PROCESS(
+  COMMAND ${CMAKE_COMMAND} -E compare_files
+    ${OUT_DIR}/cascade_sweep_j1.csv ${OUT_DIR}/cascade_sweep_j4.csv
+  RESULT_VARIABLE result)
+IF(NOT result EQUAL 0)
+  MESSAGE(FATAL_ERROR "sweep output differs between -j 1 and -j 4")
+ENDIF()
@@ -0,0 +1,136 @@
+#include "comp_cache.h"
+
+namespace mbmore {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Fractions are normalized here, as MatQuery does, so that they match
+// atom_frac/mass_frac for compositions that are not normalized.
+CompProperties CalcCompProperties(cyclus::Composition::Ptr comp) {
+  CompProperties props;
+  props.u235_atom_frac = 0;
+  props.u238_atom_frac = 0;
+  props.u235_mass_frac = 0;
+  props.u238_mass_frac = 0;
+  props.assay = 0;
+  props.extra_u = false;
+  props.other_elem = false;
+
+  const cyclus::CompMap& atom = comp->atom();
+  double atom_total = 0;
+  for (cyclus::CompMap::const_iterator it = atom.begin(); it != atom.end();
+       ++it) {
+    atom_total += it->second;
+    if (it->first == 922350000) {
+      props.u235_atom_frac = it->second;
+    } else if (it->first == 922380000) {
+      props.u238_atom_frac = it->second;
+    }
+    if (pyne::nucname::znum(it->first) == 92) {
+      if (pyne::nucname::anum(it->first) != 235 &&
+          pyne::nucname::anum(it->first) != 238 && it->second > 0) {
+        props.extra_u = true;
+      }
+    } else if (it->second > 0) {
+      props.other_elem = true;
+    }
+  }
+  if (atom_total > 0) {
+    props.u235_atom_frac /= atom_total;
+    props.u238_atom_frac /= atom_total;
+  }
+
+  const cyclus::CompMap& mass = comp->mass();
+  double mass_total = 0;
+  for (cyclus::CompMap::const_iterator it = mass.begin(); it != mass.end();
+       ++it) {
+    mass_total += it->second;
+    if (it->first == 922350000) {
+      props.u235_mass_frac = it->second;
+    } else if (it->first == 922380000) {
+      props.u238_mass_frac = it->second;
+    }
+  }
+  if (mass_total > 0) {
+    props.u235_mass_frac /= mass_total;
+    props.u238_mass_frac /= mass_total;
+  }
+
+  double u_atom_frac = props.u235_atom_frac + props.u238_atom_frac;
+  if (u_atom_frac > 0) {
+    props.assay = props.u235_atom_frac / u_atom_frac;
+  }
+  return props;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+CompPropertiesCache::CompPropertiesCache()
+    : max_size_(100000), hits_(0), misses_(0) {}
+
+CompPropertiesCache& CompPropertiesCache::Instance() {
+  static CompPropertiesCache cache;
+  return cache;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// As in CascadeDesignCache, the properties are computed outside of the lock.
+CompProperties CompPropertiesCache::Get(cyclus::Composition::Ptr comp) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::unordered_map<int, CompProperties>::const_iterator it =
+        props_.find(comp->id());
+    if (it != props_.end()) {
+      hits_++;
+      return it->second;
+    }
+    misses_++;
+  }
+
+  CompProperties props = CalcCompProperties(comp);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (props_.size() >= max_size_) {
+    props_.clear();
+  }
+  props_.insert(std::make_pair(comp->id(), props));
+  return props;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+long CompPropertiesCache::hits() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return hits_;
+}
+
+long CompPropertiesCache::misses() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return misses_;
+}
+
+std::size_t CompPropertiesCache::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return props_.size();
+}
+
+std::size_t CompPropertiesCache::max_size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return max_size_;
+}
+
+void CompPropertiesCache::set_max_size(std::size_t max_size) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  max_size_ = max_size;
+}
+
+void CompPropertiesCache::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  props_.clear();
+  hits_ = 0;
+  misses_ = 0;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+CompProperties CompProps(cyclus::Material::Ptr mat) {
+  return CompPropertiesCache::Instance().Get(mat->comp());
+}
+
+} // namespace mbmore
@@ -0,0 +1,73 @@
+#ifndef MBMORE_SRC_COMP_CACHE_H_
+#define MBMORE_SRC_COMP_CACHE_H_
+
+#include <cstddef>
+#include <mutex>
+#include <unordered_map>
+
+#include "cyclus.h"
+
+namespace mbmore {
+
+  // Uranium content of a composition, as needed by the enrichment
+  // archetypes and their converters. Fractions are of the whole composition.
+  struct CompProperties {
+    double u235_atom_frac;
+    double u238_atom_frac;
+    double u235_mass_frac;
+    double u238_mass_frac;
+    double assay;     // U235 atom fraction of the uranium (as UraniumAssay)
+    bool extra_u;     // uranium isotopes other than U235 and U238
+    bool other_elem;  // elements other than uranium
+
+    // mass fraction of U235 + U238
+    double natu_mass_frac() const { return u235_mass_frac + u238_mass_frac; }
+  };
+
+  // Computes the properties of comp directly (no caching)
+  CompProperties CalcCompProperties(cyclus::Composition::Ptr comp);
+
+  /// @class CompPropertiesCache
+  ///
+  /// @brief Process-wide, thread-safe memo of composition properties keyed
+  /// by composition id. Compositions are immutable and their ids are never
+  /// reused, so entries never go stale; the cache is emptied when it grows
+  /// past max_size to bound the memory held for compositions no longer in
+  /// use.
+  class CompPropertiesCache {
+   public:
+    // The single cache shared by all agents in the process
+    static CompPropertiesCache& Instance();
+
+    // Returns the stored properties of comp, computing them on a miss
+    CompProperties Get(cyclus::Composition::Ptr comp);
+
+    // Number of lookups answered from / added to the cache
+    long hits() const;
+    long misses() const;
+
+    // Number of stored compositions
+    std::size_t size() const;
+
+    std::size_t max_size() const;
+    void set_max_size(std::size_t max_size);
+
+    // Removes all entries and resets the counters
+    void Clear();
+
+   private:
+    CompPropertiesCache();
+
+    mutable std::mutex mutex_;
+    std::unordered_map<int, CompProperties> props_;
+    std::size_t max_size_;
+    long hits_;
+    long misses_;
+  };
+
+  // Properties of the composition of mat, from the shared cache
+  CompProperties CompProps(cyclus::Material::Ptr mat);
+
+} // namespace mbmore
+
+#endif  //  MBMORE_SRC_COMP_CACHE_H_
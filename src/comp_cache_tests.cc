@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+
+#include "comp_cache.h"
+
+#include "agent_tests.h"
+#include "context.h"
+#include "facility_tests.h"
+
+namespace mbmore {
+
+  namespace compcachetests {
+    const double tol = 1e-12;
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Cached properties match MatQuery and UraniumAssay
+TEST(Comp_Cache_Test, MatchesMatQuery) {
+  using cyclus::Material;
+  using cyclus::toolkit::MatQuery;
+
+  cyclus::CompMap cm;
+  cm[922340000] = 0.0001;
+  cm[922350000] = 0.04;
+  cm[922380000] = 0.86;
+  cm[80160000] = 0.10;
+  Material::Ptr mat = Material::CreateUntracked(
+      5, cyclus::Composition::CreateFromMass(cm));
+
+  CompProperties props = CompProps(mat);
+  MatQuery mq(mat);
+  EXPECT_NEAR(props.u235_atom_frac, mq.atom_frac(922350000), tol);
+  EXPECT_NEAR(props.u238_atom_frac, mq.atom_frac(922380000), tol);
+  EXPECT_NEAR(props.u235_mass_frac, mq.mass_frac(922350000), tol);
+  EXPECT_NEAR(props.u238_mass_frac, mq.mass_frac(922380000), tol);
+  EXPECT_NEAR(props.assay, cyclus::toolkit::UraniumAssay(mat), tol);
+  EXPECT_TRUE(props.extra_u);
+  EXPECT_TRUE(props.other_elem);
+
+  cyclus::CompMap natu;
+  natu[922350000] = 0.0071;
+  natu[922380000] = 0.9929;
+  props = CompProps(Material::CreateUntracked(
+      1, cyclus::Composition::CreateFromMass(natu)));
+  EXPECT_NEAR(props.natu_mass_frac(), 1.0, tol);
+  EXPECT_FALSE(props.extra_u);
+  EXPECT_FALSE(props.other_elem);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Materials sharing a composition are answered from the cache, and the
+// cache is emptied rather than growing past its maximum size
+TEST(Comp_Cache_Test, HitsAndMaxSize) {
+  CompPropertiesCache& cache = CompPropertiesCache::Instance();
+  cache.Clear();
+  std::size_t max_size = cache.max_size();
+
+  cyclus::CompMap cm;
+  cm[922350000] = 0.0071;
+  cm[922380000] = 0.9929;
+  cyclus::Composition::Ptr comp = cyclus::Composition::CreateFromMass(cm);
+  CompProps(cyclus::Material::CreateUntracked(1, comp));
+  CompProps(cyclus::Material::CreateUntracked(2, comp));
+  EXPECT_EQ(cache.misses(), 1);
+  EXPECT_EQ(cache.hits(), 1);
+  EXPECT_EQ(cache.size(), 1);
+
+  cache.set_max_size(2);
+  for (int i = 0; i < 5; i++) {
+    cm[922350000] = 0.001 * (i + 1);
+    cache.Get(cyclus::Composition::CreateFromMass(cm));
+    EXPECT_LE(cache.size(), 2);
+  }
+
+  cache.set_max_size(max_size);
+  cache.Clear();
+  EXPECT_EQ(cache.size(), 0);
+}
+
+  } // namespace compcachetests
+} // namespace mbmore
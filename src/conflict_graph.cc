@@ -0,0 +1,92 @@
+#include "conflict_graph.h"
+
+namespace mbmore {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+ConflictGraph::ConflictGraph() : offsets_(1, 0) {}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// The map is ordered by primary state, so each state's relations are
+// appended as one contiguous row.
+void ConflictGraph::Build(
+    const std::map<std::pair<std::string, std::string>, int>& relations) {
+  std::map<std::string, int> old_status;
+  for (int i = 0; i < names_.size(); i++) {
+    old_status[names_[i]] = status_[i];
+  }
+  ids_.clear();
+  names_.clear();
+  status_.clear();
+  offsets_.assign(1, 0);
+  others_.clear();
+  relations_.clear();
+
+  std::map<std::pair<std::string, std::string>, int>::const_iterator it;
+  for (it = relations.begin(); it != relations.end(); ++it) {
+    AddState(it->first.first);
+    AddState(it->first.second);
+  }
+
+  std::vector<int> count(names_.size(), 0);
+  for (it = relations.begin(); it != relations.end(); ++it) {
+    count[ids_[it->first.first]]++;
+  }
+  offsets_.resize(names_.size() + 1);
+  offsets_[0] = 0;
+  for (int i = 0; i < names_.size(); i++) {
+    offsets_[i + 1] = offsets_[i] + count[i];
+  }
+  others_.resize(relations.size());
+  relations_.resize(relations.size());
+  std::vector<int> next(offsets_.begin(), offsets_.end() - 1);
+  for (it = relations.begin(); it != relations.end(); ++it) {
+    int pos = next[ids_[it->first.first]]++;
+    others_[pos] = ids_[it->first.second];
+    relations_[pos] = it->second;
+  }
+
+  std::map<std::string, int>::const_iterator st;
+  for (st = old_status.begin(); st != old_status.end(); ++st) {
+    set_status(AddState(st->first), st->second);
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+int ConflictGraph::FindState(const std::string& name) const {
+  std::map<std::string, int>::const_iterator it = ids_.find(name);
+  return (it == ids_.end()) ? -1 : it->second;
+}
+
+int ConflictGraph::AddState(const std::string& name) {
+  std::map<std::string, int>::iterator it = ids_.find(name);
+  if (it != ids_.end()) {
+    return it->second;
+  }
+  int id = names_.size();
+  ids_[name] = id;
+  names_.push_back(name);
+  status_.push_back(0);
+  offsets_.push_back(offsets_.back());
+  return id;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void ConflictGraph::SetRelation(const std::string& primary,
+                                const std::string& other, int relation) {
+  int a = AddState(primary);
+  int b = AddState(other);
+  for (int pos = offsets_[a]; pos < offsets_[a + 1]; pos++) {
+    if (others_[pos] == b) {
+      relations_[pos] = relation;
+      return;
+    }
+  }
+  int pos = offsets_[a + 1];
+  others_.insert(others_.begin() + pos, b);
+  relations_.insert(relations_.begin() + pos, relation);
+  for (int i = a + 1; i < offsets_.size(); i++) {
+    offsets_[i]++;
+  }
+}
+
+} // namespace mbmore
@@ -0,0 +1,69 @@
+#ifndef MBMORE_SRC_CONFLICT_GRAPH_H_
+#define MBMORE_SRC_CONFLICT_GRAPH_H_
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mbmore {
+
+  /// @class ConflictGraph
+  ///
+  /// @brief Conflict relations between states, indexed by integer state id.
+  /// Each state's relations to other states are stored contiguously
+  /// (compressed sparse rows), so one state's relations can be visited in
+  /// O(degree) without string comparisons. Each state also carries its
+  /// weapon status so a conflict score needs no map lookups.
+  class ConflictGraph {
+   public:
+    ConflictGraph();
+
+    // Replaces the graph with the relations in the (primary state, pair
+    // state) -> relation map, as in InteractRegion::p_conflict_map. Weapon
+    // statuses of states that are still present are kept.
+    void Build(const std::map<std::pair<std::string, std::string>, int>&
+               relations);
+
+    // Id of the named state, or -1 if it is not in the graph
+    int FindState(const std::string& name) const;
+
+    // Id of the named state, adding it (with no relations and weapon
+    // status 0) if it is not in the graph
+    int AddState(const std::string& name);
+
+    const std::string& name(int id) const { return names_[id]; }
+    int n_states() const { return names_.size(); }
+    int n_relations() const { return others_.size(); }
+
+    // Sets the relation of primary to other, adding the relation (and
+    // either state) if it is not in the graph. Updating an existing
+    // relation is O(degree of primary); adding one shifts the later rows.
+    void SetRelation(const std::string& primary, const std::string& other,
+                     int relation);
+
+    // Number of relations of state id, and the ids of the other states and
+    // the relation values (degree() entries each)
+    int degree(int id) const { return offsets_[id + 1] - offsets_[id]; }
+    const int* others(int id) const { return others_.data() + offsets_[id]; }
+    const int* relations(int id) const {
+      return relations_.data() + offsets_[id];
+    }
+
+    int status(int id) const { return status_[id]; }
+    void set_status(int id, int status) { status_[id] = status; }
+
+   private:
+    std::map<std::string, int> ids_;
+    std::vector<std::string> names_;
+    std::vector<int> status_;
+
+    // relations of state i are entries offsets_[i] to offsets_[i+1] - 1
+    std::vector<int> offsets_;
+    std::vector<int> others_;
+    std::vector<int> relations_;
+  };
+
+} // namespace mbmore
+
+#endif  //  MBMORE_SRC_CONFLICT_GRAPH_H_
@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+
+#include "conflict_graph.h"
+
+namespace mbmore {
+
+  namespace conflictgraphtests {
+
+    typedef std::map<std::pair<std::string, std::string>, int> RelnMap;
+
+    // relation of primary to other in the graph, or -99 if there is none
+    int Relation(const ConflictGraph& graph, const std::string& primary,
+                 const std::string& other) {
+      int a = graph.FindState(primary);
+      int b = graph.FindState(other);
+      for (int i = 0; i < graph.degree(a); i++) {
+        if (graph.others(a)[i] == b) {
+          return graph.relations(a)[i];
+        }
+      }
+      return -99;
+    }
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Each state's row holds exactly its relations from the map
+TEST(Conflict_Graph_Test, Build) {
+  RelnMap relns;
+  relns[std::make_pair("StateA", "StateB")] = 1;
+  relns[std::make_pair("StateA", "StateC")] = -1;
+  relns[std::make_pair("StateB", "StateA")] = 0;
+  relns[std::make_pair("StateD", "StateA")] = -1;
+
+  ConflictGraph graph;
+  graph.Build(relns);
+  EXPECT_EQ(graph.n_states(), 4);
+  EXPECT_EQ(graph.n_relations(), 4);
+  EXPECT_EQ(graph.FindState("StateE"), -1);
+
+  EXPECT_EQ(graph.degree(graph.FindState("StateA")), 2);
+  EXPECT_EQ(graph.degree(graph.FindState("StateB")), 1);
+  EXPECT_EQ(graph.degree(graph.FindState("StateC")), 0);
+  EXPECT_EQ(graph.degree(graph.FindState("StateD")), 1);
+
+  RelnMap::const_iterator it;
+  for (it = relns.begin(); it != relns.end(); ++it) {
+    EXPECT_EQ(Relation(graph, it->first.first, it->first.second),
+              it->second);
+  }
+  EXPECT_EQ(graph.name(graph.FindState("StateD")), "StateD");
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Relations are updated in place or inserted into the right row, and
+// weapon statuses survive a rebuild
+TEST(Conflict_Graph_Test, SetRelation) {
+  RelnMap relns;
+  relns[std::make_pair("StateA", "StateB")] = 1;
+  relns[std::make_pair("StateC", "StateA")] = 0;
+
+  ConflictGraph graph;
+  graph.Build(relns);
+  graph.set_status(graph.FindState("StateB"), 2);
+
+  graph.SetRelation("StateA", "StateB", -1);
+  EXPECT_EQ(graph.n_relations(), 2);
+  EXPECT_EQ(Relation(graph, "StateA", "StateB"), -1);
+
+  graph.SetRelation("StateB", "StateC", 1);
+  graph.SetRelation("StateA", "StateC", 0);
+  graph.SetRelation("StateE", "StateA", -1);
+  EXPECT_EQ(graph.n_relations(), 5);
+  EXPECT_EQ(graph.n_states(), 4);
+  EXPECT_EQ(Relation(graph, "StateA", "StateB"), -1);
+  EXPECT_EQ(Relation(graph, "StateA", "StateC"), 0);
+  EXPECT_EQ(Relation(graph, "StateB", "StateC"), 1);
+  EXPECT_EQ(Relation(graph, "StateC", "StateA"), 0);
+  EXPECT_EQ(Relation(graph, "StateE", "StateA"), -1);
+  EXPECT_EQ(graph.status(graph.FindState("StateB")), 2);
+
+  graph.Build(relns);
+  EXPECT_EQ(graph.n_relations(), 2);
+  EXPECT_EQ(graph.status(graph.FindState("StateB")), 2);
+  EXPECT_EQ(graph.status(graph.FindState("StateA")), 0);
+}
+
+  } // namespace conflictgraphtests
+} // namespace mbmore
@@ -0,0 +1,34 @@
+#include "enrich_converters.h"
+
+namespace mbmore {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+double SWUConverter::SwuPerKg(cyclus::Composition::Ptr comp) const {
+  std::unordered_map<int, double>::const_iterator it =
+      factors_.find(comp->id());
+  if (it != factors_.end()) {
+    return it->second;
+  }
+  cyclus::toolkit::Assays assays(
+      feed_, CompPropertiesCache::Instance().Get(comp).assay, tails_);
+  double factor = cyclus::toolkit::SwuRequired(1.0, assays);
+  factors_[comp->id()] = factor;
+  return factor;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+double NatUConverter::FeedPerKg(cyclus::Composition::Ptr comp) const {
+  std::unordered_map<int, double>::const_iterator it =
+      factors_.find(comp->id());
+  if (it != factors_.end()) {
+    return it->second;
+  }
+  CompProperties props = CompPropertiesCache::Instance().Get(comp);
+  cyclus::toolkit::Assays assays(feed_, props.assay, tails_);
+  double factor =
+      cyclus::toolkit::FeedQty(1.0, assays) / props.natu_mass_frac();
+  factors_[comp->id()] = factor;
+  return factor;
+}
+
+} // namespace mbmore
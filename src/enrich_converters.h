@@ -0,0 +1,83 @@
+#ifndef MBMORE_SRC_ENRICH_CONVERTERS_H_
+#define MBMORE_SRC_ENRICH_CONVERTERS_H_
+
+#include <unordered_map>
+
+#include "comp_cache.h"
+#include "cyclus.h"
+
+namespace mbmore {
+
+// SWU and feed are both proportional to the quantity of product, so the
+// converters below compute the requirement per kg of product once for each
+// composition they see and then scale it by the quantity. The factors are
+// kept for the life of the converter, which is one resource exchange (a new
+// converter is made with each bid portfolio).
+
+/// @class SWUConverter
+///
+/// @brief The SWUConverter is a simple Converter class for material to
+/// determine the amount of SWU required for their proposed enrichment
+class SWUConverter : public cyclus::Converter<cyclus::Material> {
+ public:
+  SWUConverter(double feed_commod, double tails)
+      : feed_(feed_commod), tails_(tails) {}
+  virtual ~SWUConverter() {}
+
+  /// @brief provides a conversion for the SWU required
+  virtual double convert(
+      cyclus::Material::Ptr m, cyclus::Arc const* a = NULL,
+      cyclus::ExchangeTranslationContext<cyclus::Material> const* ctx =
+          NULL) const {
+    return m->quantity() * SwuPerKg(m->comp());
+  }
+
+  /// @returns true if Converter is a SWUConverter and feed and tails equal
+  virtual bool operator==(Converter& other) const {
+    SWUConverter* cast = dynamic_cast<SWUConverter*>(&other);
+    return cast != NULL && feed_ == cast->feed_ && tails_ == cast->tails_;
+  }
+
+ private:
+  double SwuPerKg(cyclus::Composition::Ptr comp) const;
+
+  double feed_, tails_;
+  mutable std::unordered_map<int, double> factors_;  // by composition id
+};
+
+/// @class NatUConverter
+///
+/// @brief The NatUConverter is a simple Converter class for material to
+/// determine the amount of natural uranium required for their proposed
+/// enrichment
+class NatUConverter : public cyclus::Converter<cyclus::Material> {
+ public:
+  NatUConverter(double feed_commod, double tails)
+      : feed_(feed_commod), tails_(tails) {}
+  virtual ~NatUConverter() {}
+
+  /// @brief provides a conversion for the amount of natural Uranium required
+  virtual double convert(
+      cyclus::Material::Ptr m, cyclus::Arc const* a = NULL,
+      cyclus::ExchangeTranslationContext<cyclus::Material> const* ctx =
+          NULL) const {
+    return m->quantity() * FeedPerKg(m->comp());
+  }
+
+  /// @returns true if Converter is a NatUConverter and feed and tails equal
+  virtual bool operator==(Converter& other) const {
+    NatUConverter* cast = dynamic_cast<NatUConverter*>(&other);
+    return cast != NULL && feed_ == cast->feed_ && tails_ == cast->tails_;
+  }
+
+ private:
+  // feed per kg of product, divided by the U235 + U238 mass fraction
+  double FeedPerKg(cyclus::Composition::Ptr comp) const;
+
+  double feed_, tails_;
+  mutable std::unordered_map<int, double> factors_;  // by composition id
+};
+
+} // namespace mbmore
+
+#endif  //  MBMORE_SRC_ENRICH_CONVERTERS_H_
@@ -0,0 +1,47 @@
+#include <gtest/gtest.h>
+
+#include "enrich_converters.h"
+
+#include "agent_tests.h"
+#include "context.h"
+#include "facility_tests.h"
+
+namespace mbmore {
+
+  namespace enrichconverterstests {
+    const double feed_assay = 0.0071;
+    const double tails_assay = 0.003;
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Memoized per-kg factors give the same SWU and feed as the direct
+// calculation, for repeated and differently sized requests
+TEST(Enrich_Converters_Test, MatchDirectCalculation) {
+  using cyclus::Material;
+  using cyclus::toolkit::Assays;
+
+  cyclus::CompMap cm;
+  cm[922350000] = 0.04;
+  cm[922380000] = 0.86;
+  cm[80160000] = 0.10;
+  cyclus::Composition::Ptr comp = cyclus::Composition::CreateFromMass(cm);
+
+  SWUConverter sc(feed_assay, tails_assay);
+  NatUConverter nc(feed_assay, tails_assay);
+  double qtys[] = {10, 2.5, 10};
+  for (int i = 0; i < 3; i++) {
+    Material::Ptr mat = Material::CreateUntracked(qtys[i], comp);
+    Assays assays(feed_assay, cyclus::toolkit::UraniumAssay(mat),
+                  tails_assay);
+    cyclus::toolkit::MatQuery mq(mat);
+    double natu_frac =
+        mq.mass_frac(922350000) + mq.mass_frac(922380000);
+
+    EXPECT_NEAR(sc.convert(mat),
+                cyclus::toolkit::SwuRequired(qtys[i], assays), 1e-9);
+    EXPECT_NEAR(nc.convert(mat),
+                cyclus::toolkit::FeedQty(qtys[i], assays) / natu_frac, 1e-9);
+  }
+}
+
+  } // namespace enrichconverterstests
+} // namespace mbmore
@@ -1,12 +1,26 @@
 #define _USE_MATH_DEFINES
 
+#include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <cstdlib>
 #include <ctime>  // to make truly random
 #include <iostream>
 #include <iterator>
+#include <limits>
+#include <map>
 #include "cyclus.h"
 #include "enrich_functions.h"
+#include "comp_cache.h"
+
+// AVX2 kernels are compiled with a per-function target attribute so the rest
+// of the library does not require AVX2.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MBMORE_AVX2_BATCH 1
+#include <immintrin.h>
+#else
+#define MBMORE_AVX2_BATCH 0
+#endif
 
 namespace mbmore {
 
@@ -126,32 +140,77 @@ std::pair<double, double> StagesPerCascade(double alpha, double feed_assay,
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 // Determine number of stages required to reach ideal cascade product assay
 // (requires integer number of stages, so output may exceed target assay)
+//
+// Each enriching stage multiplies the abundance ratio R = N/(1-N) by alpha
+// and each stripping stage divides it by alpha, so the stage counts follow
+// directly from log(R_target/R_start)/log(alpha). The logarithm is only
+// used as a first guess; the integer count is then checked against the
+// assay reached after n and n-1 stages so that it matches the stage by stage
+// calculation where the ratio falls (to rounding) on a stage boundary.
+
+namespace {
+
+double AbundanceRatio(double assay) {
+  return assay / (1.0 - assay);
+}
+
+double AssayFromRatio(double ratio) {
+  return ratio / (1.0 + ratio);
+}
+
+// Assay after multiplying the abundance ratio of start_assay by alpha^n
+double AssayAfterStages(double alpha, double start_assay, int n) {
+  return AssayFromRatio(AbundanceRatio(start_assay) * pow(alpha, n));
+}
+
+}  // namespace
 
 std::pair<int, int> FindNStages(double alpha, double feed_assay,
                                 double product_assay, double waste_assay) {
-  using std::pair;
+  if (!(alpha > 1.0)) {
+    throw cyclus::ValueError("Separation factor alpha must be greater than 1");
+  }
+  // The stage counts are logs of abundance ratios, which are only finite
+  // for assays strictly between 0 and 1
+  if (!(waste_assay > 0) || !(product_assay < 1)) {
+    throw cyclus::ValueError("Assays must be between 0 and 1");
+  }
+  if (!(waste_assay < feed_assay) || !(feed_assay < product_assay)) {
+    throw cyclus::ValueError("Assays must be ordered waste < feed < product");
+  }
+  double log_alpha = log(alpha);
+
+  // Calculate number of enriching stages (at least 1)
+  double n_enrich_exact = log(AbundanceRatio(product_assay) /
+                              AbundanceRatio(feed_assay)) / log_alpha;
+  int ideal_enrich_stage = std::max(1, int(std::ceil(n_enrich_exact)));
+  while ((ideal_enrich_stage > 1) &&
+         (AssayAfterStages(alpha, feed_assay, ideal_enrich_stage - 1) >=
+          product_assay)) {
+    ideal_enrich_stage -= 1;
+  }
+  while (AssayAfterStages(alpha, feed_assay, ideal_enrich_stage) <
+         product_assay) {
+    ideal_enrich_stage += 1;
+  }
 
-  int ideal_enrich_stage = 0;
+  // Calculate number of stripping stages, starting from the waste of the
+  // first enriching stage
+  double stage_waste_assay = WasteAssayByAlpha(alpha, feed_assay);
   int ideal_strip_stage = 0;
-  double stage_feed_assay = feed_assay;
-  double stage_product_assay = feed_assay;
-  double stage_waste_assay = feed_assay;  // start w/waste of 1st enrich stage
-
-  // Calculate number of enriching stages
-  while (stage_product_assay < product_assay) {
-    stage_product_assay = ProductAssayByAlpha(alpha, stage_feed_assay);
-    if (ideal_enrich_stage == 0) {
-      stage_waste_assay = WasteAssayByAlpha(alpha, stage_feed_assay);
+  if (stage_waste_assay > waste_assay) {
+    double n_strip_exact = log(AbundanceRatio(stage_waste_assay) /
+                               AbundanceRatio(waste_assay)) / log_alpha;
+    ideal_strip_stage = std::max(1, int(std::ceil(n_strip_exact)));
+    while ((ideal_strip_stage > 1) &&
+           (AssayAfterStages(alpha, stage_waste_assay,
+                             -(ideal_strip_stage - 1)) <= waste_assay)) {
+      ideal_strip_stage -= 1;
+    }
+    while (AssayAfterStages(alpha, stage_waste_assay, -ideal_strip_stage) >
+           waste_assay) {
+      ideal_strip_stage += 1;
     }
-    ideal_enrich_stage += 1;
-    stage_feed_assay = stage_product_assay;
-  }
-  // Calculate number of stripping stages
-  stage_feed_assay = stage_waste_assay;
-  while (stage_waste_assay > waste_assay) {
-    stage_waste_assay = WasteAssayByAlpha(alpha, stage_feed_assay);
-    ideal_strip_stage += 1;
-    stage_feed_assay = stage_waste_assay;
   }
 
   std::pair<int, int> stages =
@@ -174,6 +233,78 @@ double WasteAssayFromNStages(double alpha, double feed_assay,
           ((1 - feed_assay) / feed_assay) * exp(strip_stages * (alpha - 1.0)));
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Batch version of CalcV, used for the stage value functions of the
+// off-design stage balance.
+// The AVX2 path does the arithmetic four values at a time with the same
+// operations (and therefore the same rounding) as the scalar function above.
+// There is no vector log instruction, so the logs are still evaluated one
+// value at a time into the output buffer and then combined in vector form.
+// The path is chosen at runtime from the CPU features.
+
+namespace {
+
+// Read by every batch call, possibly from several threads (e.g. the
+// parameter sweep), so it is atomic
+std::atomic<bool> simd_batch_kernels(true);
+
+#if MBMORE_AVX2_BATCH
+
+bool CpuHasAvx2() {
+  static const bool has_avx2 = __builtin_cpu_supports("avx2");
+  return has_avx2;
+}
+
+__attribute__((target("avx2")))
+void CalcVAvx2(const double* assay, double* v, int n) {
+  const __m256d one = _mm256_set1_pd(1.0);
+  const __m256d two = _mm256_set1_pd(2.0);
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256d x = _mm256_loadu_pd(assay + i);
+    __m256d ratio = _mm256_div_pd(x, _mm256_sub_pd(one, x));
+    double logs[4];
+    _mm256_storeu_pd(logs, ratio);
+    for (int k = 0; k < 4; k++) {
+      logs[k] = log(logs[k]);
+    }
+    __m256d lead = _mm256_sub_pd(_mm256_mul_pd(two, x), one);
+    _mm256_storeu_pd(v + i, _mm256_mul_pd(lead, _mm256_loadu_pd(logs)));
+  }
+  for (; i < n; i++) {
+    v[i] = CalcV(assay[i]);
+  }
+}
+
+#endif  // MBMORE_AVX2_BATCH
+
+}  // namespace
+
+void UseSimdBatchKernels(bool use_simd) {
+  simd_batch_kernels.store(use_simd, std::memory_order_relaxed);
+}
+
+bool SimdBatchKernels() {
+#if MBMORE_AVX2_BATCH
+  return simd_batch_kernels.load(std::memory_order_relaxed) &&
+         CpuHasAvx2();
+#else
+  return false;
+#endif
+}
+
+void CalcV(const double* assay, double* v, int n) {
+#if MBMORE_AVX2_BATCH
+  if (SimdBatchKernels()) {
+    CalcVAvx2(assay, v, n);
+    return;
+  }
+#endif
+  for (int i = 0; i < n; i++) {
+    v[i] = CalcV(assay[i]);
+  }
+}
+
 double MachinesPerStage(double alpha, double del_U, double stage_feed) {
   return stage_feed / (2.0 * del_U / (pow((alpha - 1.0), 2)));
 }
@@ -220,29 +351,22 @@ double DelUByCascadeConfig(double product_assay, double waste_assay,
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 // Calculate steady-state flow rates into each cascade stage
-// Linear system of equations in form AX = B, where A is nxn square matrix
-// of linear equations for the flow rates of each stage and B are the external
-// feeds for the stage. External feed is zero for all stages accept cascade
-// feed stage (F_0) stages start with last strip stage [-2, -1, 0, 1, 2]
-//  http://www.physics.utah.edu/~detar/phys6720/handouts/lapack.html
+// Linear system of equations in form AX = B, where A is the nxn tridiagonal
+// matrix of linear equations for the flow rates of each stage and B are the
+// external feeds for the stage. External feed is zero for all stages accept
+// cascade feed stage (F_0) stages start with last strip stage [-2, -1, 0, 1, 2]
+// Only the three diagonals of A are stored, so the cost is O(n) in time and
+// memory and there is no limit on the number of stages.
+//  http://www.netlib.org/lapack/explore-html/d1/d88/group__double_g_tsolve.html
 //
 std::vector<double> CalcFeedFlows(std::pair<int, int> n_st, double cascade_feed,
                                   double cut) {
-  // This is the Max # of stages in cascade. It cannot be passed in due to
-  // how memory is allocated and so must be hardcoded. It's been chosen
-  // to be much larger than it should ever need to be
-  int max_stages = 100;
-
-  int n_enrich = n_st.first;
   int n_strip = n_st.second;
   int n_stages = n_st.first + n_st.second;
 
-  // LAPACK takes the external flow feeds as B, and then returns a modified
-  // version of the same array now representing the solution flow rates.
-
-  // Build Array with pointers
-  double flow_eqns[max_stages][max_stages];
-  double flows[1][max_stages];
+  if (n_stages < 1) {
+    return std::vector<double>();
+  }
 
   // build matrix of equations in this pattern
   // [[ -1, 1-cut,    0,     0,      0]       [[0]
@@ -251,53 +375,49 @@ std::vector<double> CalcFeedFlows(std::pair<int, int> n_st, double cascade_feed,
   //  [  0,     0,   cut,    -1, 1-cut]        [0]
   //  [  0,     0,     0,   cut,    -1]]       [0]]
   //
-  for (int row_idx = 0; row_idx < max_stages; row_idx++) {
-    // fill the array with zeros, then update individual elements as nonzero
-    flows[0][row_idx] = 0;
-    for (int fill_idx = 0; fill_idx < max_stages; fill_idx++) {
-      flow_eqns[fill_idx][row_idx] = 0;
-    }
-    // Required do to the artificial 'Max Stages' defn. Only calculate
-    // non-zero matrix elements where stages really exist.
-    if (row_idx < n_stages) {
-      int i = row_idx - n_strip;
-      int col_idx = n_strip + i;
-      flow_eqns[col_idx][row_idx] = -1;
-      if (col_idx != 0) {
-        flow_eqns[col_idx - 1][row_idx] = cut;
-      }
-      if (col_idx != n_stages - 1) {
-        flow_eqns[col_idx + 1][row_idx] = (1 - cut);
-      }
-      // Add the external feed for the cascade
-      if (i == 0) {
-        flows[0][row_idx] = -1 * cascade_feed;
-      }
-    }
+  // sub_diag holds the 'cut' entries below the diagonal and super_diag holds
+  // the '1-cut' entries above it.
+  std::vector<double> sub_diag(std::max(n_stages - 1, 1), cut);
+  std::vector<double> diag(n_stages, -1.0);
+  std::vector<double> super_diag(std::max(n_stages - 1, 1), 1.0 - cut);
+
+  // LAPACK takes the external flow feeds as B, and then returns a modified
+  // version of the same array now representing the solution flow rates.
+  std::vector<double> flows(n_stages, 0.0);
+  // Add the external feed for the cascade
+  if (n_strip < n_stages) {
+    flows[n_strip] = -1 * cascade_feed;
   }
 
   // LAPACK solver variables
-  int nrhs = 1;          // 1 column solution
-  int lda = max_stages;  // must be >= MAX(1,N)
-  int ldb = max_stages;  // must be >= MAX(1,N)
-  int ipiv[max_stages];
+  int nrhs = 1;         // 1 column solution
+  int ldb = n_stages;   // must be >= MAX(1,N)
   int info;
 
   // Solve the linear system
-  dgesv_(&n_stages, &nrhs, &flow_eqns[0][0], &lda, ipiv, &flows[0][0], &ldb,
-         &info);
+  dgtsv_(&n_stages, &nrhs, &sub_diag[0], &diag[0], &super_diag[0], &flows[0],
+         &ldb, &info);
 
   // Check for success
   if (info != 0) {
-    std::cerr << "LAPACK linear solver dgesv returned error " << info << "\n";
+    std::cerr << "LAPACK linear solver dgtsv returned error " << info << "\n";
   }
 
-  std::vector<double> final_flows;
-  for (int i = 0; i < n_stages; i++) {
-    final_flows.push_back(flows[0][i]);
+  return flows;
+}
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Unless the ideal number of machines is Very close to an integer value,
+// round up to next integer to preserve steady-state flow balance
+int IntegerMachines(double n_mach_exact) {
+  double machine_tol = 0.01;
+
+  int n_mach = (int)n_mach_exact;
+  if (std::abs(n_mach_exact - n_mach) > machine_tol) {
+    n_mach = int(n_mach_exact) + 1;
   }
-  return final_flows;
+  return n_mach;
 }
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 // Determine number of machines in each stage of the cascade, and total
 // output flow from each stage
@@ -305,8 +425,6 @@ std::vector<double> CalcFeedFlows(std::pair<int, int> n_st, double cascade_feed,
 std::vector<std::pair<int, double>> CalcStageFeatures(
     double feed_assay, double alpha, double del_U, double cut,
     std::pair<int, int> n_st, std::vector<double> feed_flow) {
-  double machine_tol = 0.01;
-
   int n_enrich = n_st.first;
   int n_strip = n_st.second;
   int n_stages = n_st.first + n_st.second;
@@ -320,13 +438,7 @@ std::vector<std::pair<int, double>> CalcStageFeatures(
   for (int i = 0; i < n_enrich; i++) {
     int curr_stage = i + n_strip;
     double stage_feed = feed_flow[curr_stage];
-    double n_mach_exact = MachinesPerStage(alpha, del_U, stage_feed);
-    // unless the ideal number of machines is Very close to an integer value,
-    // round up to next integer to preserve steady-state flow balance
-    int n_mach = (int)n_mach_exact;
-    if (std::abs(n_mach_exact - n_mach) > machine_tol) {
-      n_mach = int(n_mach_exact) + 1;
-    }
+    int n_mach = IntegerMachines(MachinesPerStage(alpha, del_U, stage_feed));
     double stage_product = stage_feed * cut;
     std::pair<int, double> curr_info = std::make_pair(n_mach, stage_product);
     stage_info.push_back(curr_info);
@@ -345,13 +457,7 @@ std::vector<std::pair<int, double>> CalcStageFeatures(
     int curr_stage = i - n_strip;
 
     double stage_feed = feed_flow[i];
-    double n_mach_exact = MachinesPerStage(alpha, del_U, stage_feed);
-    // unless the ideal number of machines is Very close to an integer value,
-    // round up to next integer to preserve steady-state flow balance
-    int n_mach = (int)n_mach_exact;
-    if (std::abs(n_mach_exact - n_mach) > machine_tol) {
-      n_mach = int(n_mach_exact) + 1;
-    }
+    int n_mach = IntegerMachines(MachinesPerStage(alpha, del_U, stage_feed));
     double stage_product = stage_feed * cut;
     std::pair<int, double> curr_info = std::make_pair(n_mach, stage_product);
     stage_info.insert(stage_info.begin(), curr_info);
@@ -373,99 +479,496 @@ int FindTotalMachines(std::vector<std::pair<int, double>> stage_info) {
   return machines_needed;
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Total integer machines in a cascade whose ideal machines per stage for a
+// unit cascade feed are unit_machines, when the cascade feed is cascade_feed.
+// Stage flows are linear in the cascade feed, so the flows only need to be
+// solved once for a unit feed and then scaled.
+int MachinesForFeed(const std::vector<double>& unit_machines,
+                    double cascade_feed, int* min_stage_machines) {
+  int machines_needed = 0;
+  int min_machines = std::numeric_limits<int>::max();
+  for (int i = 0; i < unit_machines.size(); i++) {
+    int n_mach = IntegerMachines(cascade_feed * unit_machines[i]);
+    machines_needed += n_mach;
+    min_machines = std::min(min_machines, n_mach);
+  }
+  if (min_stage_machines != NULL) {
+    *min_stage_machines = min_machines;
+  }
+  return machines_needed;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Find the largest cascade feed whose integer number of machines does not
+// exceed max_centrifuges. The total number of machines is a monotone step
+// function of the feed, so the answer is bracketed using the bounds
+//   feed*K - tol*n <= machines(feed) < feed*K + n
+// (K = ideal machines per unit feed, n = number of stages) and then bisected
+// on the integer machine count. The final feed is moved up to the exact
+// point where the next stage would need another machine.
+CascadeSize SizeCascade(double alpha, double del_U, double cut,
+                        int max_centrifuges, std::pair<int, int> n_stages) {
+  CascadeSize size;
+  size.n_machines = 0;
+  size.feed_flow = 0;
+  size.unused_machines = 0;
+
+  if (max_centrifuges < 0) {
+    throw cyclus::ValueError("Number of available centrifuges must not be "
+                             "negative");
+  }
+  // No centrifuges available: the facility has no cascade (as before the
+  // cascade was sized by bisection) rather than a failed design
+  if (max_centrifuges == 0) {
+    return size;
+  }
+
+  double machine_tol = 0.01;
+  int max_iter = 200;
+
+  std::vector<double> unit_flows = CalcFeedFlows(n_stages, 1.0, cut);
+  int n_tot = unit_flows.size();
+
+  std::vector<double> unit_machines(n_tot);
+  double machines_per_feed = 0;
+  for (int i = 0; i < n_tot; i++) {
+    unit_machines[i] = MachinesPerStage(alpha, del_U, unit_flows[i]);
+    machines_per_feed += unit_machines[i];
+  }
+  if ((n_tot == 0) || !(machines_per_feed > 0)) {
+    throw cyclus::ValueError(
+        "Could not design a cascade using the max allowed machines");
+  }
+
+  // bracket the answer: machines(lo_feed) <= max < machines(hi_feed)
+  double lo_feed =
+      std::max(0.0, (max_centrifuges - n_tot) / machines_per_feed);
+  double hi_feed =
+      (max_centrifuges + machine_tol * n_tot + 1) / machines_per_feed;
+
+  int lo_machines = MachinesForFeed(unit_machines, lo_feed, NULL);
+  for (int i = 0; i < max_iter; i++) {
+    double mid_feed = 0.5 * (lo_feed + hi_feed);
+    if ((mid_feed <= lo_feed) || (mid_feed >= hi_feed)) {
+      break;
+    }
+    int mid_machines = MachinesForFeed(unit_machines, mid_feed, NULL);
+    if (mid_machines <= max_centrifuges) {
+      lo_feed = mid_feed;
+      lo_machines = mid_machines;
+    } else {
+      hi_feed = mid_feed;
+    }
+  }
+
+  // Every stage keeps its machine count up to the feed where its ideal
+  // number of machines reaches n_mach + tol, so the largest feed with the
+  // same machine layout is the smallest of those points.
+  double opt_feed = hi_feed;
+  for (int i = 0; i < n_tot; i++) {
+    if (unit_machines[i] > 0) {
+      int n_mach = IntegerMachines(lo_feed * unit_machines[i]);
+      opt_feed = std::min(opt_feed, (n_mach + machine_tol) / unit_machines[i]);
+    }
+  }
+  int min_stage_machines;
+  int opt_machines = MachinesForFeed(unit_machines, opt_feed,
+                                     &min_stage_machines);
+  if ((opt_feed < lo_feed) || (opt_machines != lo_machines)) {
+    opt_feed = lo_feed;
+    opt_machines = MachinesForFeed(unit_machines, opt_feed,
+                                   &min_stage_machines);
+  }
+
+  // If any stage of the cascade has zero centrifuges then there are
+  // not enough to achieve the target enrichment
+  if (min_stage_machines < 1) {
+    throw cyclus::ValueError(
+        "Not enough available centrifuges to achieve target enrichment "
+        "level");
+  }
+
+  size.n_machines = opt_machines;
+  size.feed_flow = opt_feed;
+  size.unused_machines = max_centrifuges - opt_machines;
+  return size;
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 std::pair<int, double> DesignCascade(double design_feed,
 				     double design_alpha,
                                      double design_delU, double cut,
                                      int max_centrifuges,
                                      std::pair<int, int> n_stages) {
-  // Determine the ideal steady-state feed flows for this cascade design given
-  // the maximum potential design feed rate
-  std::vector<double> feed_flows = CalcFeedFlows(n_stages, design_feed, cut);
-
-  std::vector<std::pair<int, double>> stage_info = CalcStageFeatures(
-      design_feed, design_alpha, design_delU, cut, n_stages, feed_flows);
-
-  // Do design parameters require more centrifuges than what is available?
-  int machines_needed = FindTotalMachines(stage_info);
-
-  double optimal_feed = design_feed;
-
-  bool pos_inc = false;
-  bool neg_inc = false;
-  bool optimal_number = false;
-  double step = 1.05;
-  double step_size = 1.0;
-
-  double curr_feed = design_feed;
-  int max_tries = 10000;
-  int ntries = 0;
-
-  // If there are not enough centrifuges for optimal design
-  if (machines_needed < max_centrifuges) {
-    pos_inc = true;
-    step_size = step;
-  } else if (machines_needed > max_centrifuges) {
-    neg_inc = true;
-    step_size = 1.0 / step;
-  } else {
-    optimal_number = true;
-  }
-
-  while ((optimal_number == false) && (ntries < max_tries)) {
-    ntries += 1;
-    double last_feed = curr_feed;
-    curr_feed *= step_size;
-    feed_flows = CalcFeedFlows(n_stages, curr_feed, cut);
-    stage_info = CalcStageFeatures(curr_feed, design_alpha, design_delU, cut,
-                                   n_stages, feed_flows);
-    machines_needed = FindTotalMachines(stage_info);
-    std::pair<int, double> last_stage = stage_info.back();
-    std::cout << "# in last stage " << last_stage.first << std::endl;
-    // If cannot converge on a cascade with allowable number of centrifuges
-    if (ntries >= max_tries) {
-      throw cyclus::ValueError(
-          "Could not design a cascade using the max allowed machines");
+  // The cascade always uses as many of the available centrifuges as possible,
+  // so the design feed does not change the result.
+  CascadeSize size = SizeCascade(design_alpha, design_delU, cut,
+                                 max_centrifuges, n_stages);
+  std::pair<int, double> cascade_info =
+      std::make_pair(size.n_machines, size.feed_flow);
+  return cascade_info;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+int StageTable::TotalMachines() const {
+  int n_mach = 0;
+  for (int i = 0; i < machines.size(); i++) {
+    n_mach += machines[i];
+  }
+  return n_mach;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Fill in flows, machines and assays for each stage of an ideal cascade.
+// Enriching stages take the product of the stage below as feed, starting
+// from the cascade feed assay. Stripping stages take the tails of the stage
+// above, starting from the tails of the first enriching stage.
+StageTable BuildStageTable(double feed_assay, double alpha, double del_U,
+                           double cut, std::pair<int, int> n_st,
+                           double cascade_feed) {
+  int n_enrich = n_st.first;
+  int n_strip = n_st.second;
+  int n_stages = n_enrich + n_strip;
+
+  StageTable stages;
+  stages.n_strip = n_strip;
+  stages.cascade_feed = cascade_feed;
+  stages.alpha = alpha;
+  stages.del_U = del_U;
+  stages.cut = cut;
+  stages.feed_flow = CalcFeedFlows(n_st, 1.0, cut);
+  stages.machines.resize(n_stages);
+  stages.product_flow.resize(n_stages);
+  stages.tails_flow.resize(n_stages);
+  stages.feed_assay.resize(n_stages);
+  stages.product_assay.resize(n_stages);
+  stages.tails_assay.resize(n_stages);
+
+  double stage_feed_assay = feed_assay;
+  for (int i = n_strip; i < n_stages; i++) {
+    stages.feed_assay[i] = stage_feed_assay;
+    stages.product_assay[i] = ProductAssayByAlpha(alpha, stage_feed_assay);
+    stages.tails_assay[i] = WasteAssayByAlpha(alpha, stage_feed_assay);
+    stage_feed_assay = stages.product_assay[i];
+  }
+  stage_feed_assay = WasteAssayByAlpha(alpha, feed_assay);
+  for (int i = n_strip - 1; i >= 0; i--) {
+    stages.feed_assay[i] = stage_feed_assay;
+    stages.product_assay[i] = ProductAssayByAlpha(alpha, stage_feed_assay);
+    stages.tails_assay[i] = WasteAssayByAlpha(alpha, stage_feed_assay);
+    stage_feed_assay = stages.tails_assay[i];
+  }
+
+  // Machines are counted from the unit feed solution exactly as in
+  // SizeCascade, so a table built at a sized feed has the same layout.
+  for (int i = 0; i < n_stages; i++) {
+    double unit_machines = MachinesPerStage(alpha, del_U, stages.feed_flow[i]);
+    stages.machines[i] = IntegerMachines(cascade_feed * unit_machines);
+    double stage_feed = cascade_feed * stages.feed_flow[i];
+    stages.feed_flow[i] = stage_feed;
+    stages.product_flow[i] = stage_feed * cut;
+    stages.tails_flow[i] = stage_feed * (1 - cut);
+  }
+  return stages;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+namespace {
+
+// Tails assay of a stage with cut theta and product/tails abundance ratio q
+// fed at assay z. Substituting the stage balance theta*y + (1-theta)*w = z
+// into y/(1-y) = q*w/(1-w) gives a*w^2 + b*w + z = 0. The root is taken in
+// the form that does not cancel for small z.
+double StageTailsAssay(double q, double theta, double z) {
+  double a = -(1 - theta) * (q - 1);
+  double b = z * (q - 1) - (1 - theta) - theta * q;
+  return 2 * z / (-b + sqrt(b * b - 4 * a * z));
+}
+
+
+// Stage flows do not depend on the feed assay, so the U235 balance
+//   F_i z_i = cut F_(i-1) y_(i-1) + (1-cut) F_(i+1) w_(i+1) + feed z_f
+// is linear in the stage feed assays z_i once each stage's split y_i/z_i,
+// w_i/z_i is fixed. The splits are taken from the current assays, the
+// tridiagonal system is solved, and this is repeated until the assays stop
+// changing (a few iterations, the splits vary slowly with assay).
+// Returns the cascade product and tails assays and the ratio of cascade to
+// stage separative work.
+void StageBalance(const StageTable& stages,
+                  const std::vector<double>& unit_flow, double feed_assay,
+                  double* product_assay, double* tails_assay,
+                  double* efficiency) {
+  int n_stages = stages.size();
+  int n_strip = stages.n_strip;
+  double theta = stages.cut;
+  double q = stages.alpha * stages.alpha;
+
+  // start from the design assays shifted to the new feed
+  double shift = AbundanceRatio(feed_assay) /
+                 AbundanceRatio(stages.feed_assay[n_strip]);
+  std::vector<double> z(n_stages);
+  std::vector<double> y(n_stages);
+  std::vector<double> w(n_stages);
+  for (int i = 0; i < n_stages; i++) {
+    z[i] = AssayFromRatio(AbundanceRatio(stages.feed_assay[i]) * shift);
+  }
+
+  int max_iter = 100;
+  double tol = 1e-14;
+  int nrhs = 1;
+  int info;
+  std::vector<double> sub_diag(std::max(n_stages - 1, 1));
+  std::vector<double> diag(n_stages);
+  std::vector<double> super_diag(std::max(n_stages - 1, 1));
+  std::vector<double> rhs(n_stages);
+  for (int iter = 0; iter < max_iter; iter++) {
+    for (int i = 0; i < n_stages; i++) {
+      w[i] = StageTailsAssay(q, theta, z[i]);
+      y[i] = (z[i] - (1 - theta) * w[i]) / theta;
+    }
+    for (int i = 0; i < n_stages; i++) {
+      diag[i] = unit_flow[i];
+      rhs[i] = (i == n_strip) ? feed_assay : 0;
+      if (i > 0) {
+        sub_diag[i - 1] = -theta * unit_flow[i - 1] * y[i - 1] / z[i - 1];
+      }
+      if (i < n_stages - 1) {
+        super_diag[i] = -(1 - theta) * unit_flow[i + 1] * w[i + 1] / z[i + 1];
+      }
+    }
+    dgtsv_(&n_stages, &nrhs, &sub_diag[0], &diag[0], &super_diag[0], &rhs[0],
+           &n_stages, &info);
+    if (info != 0) {
+      throw cyclus::ValueError("Off-design stage balance could not be solved");
     }
-    // If the last stage of the cascade has zero centrifuges then there are
-    // not enough to achieve the target enrichment
-    else if (last_stage.first < 1) {
-      throw cyclus::ValueError(
-          "Not enough available centrifuges to achieve target enrichment "
-          "level");
+    double change = 0;
+    for (int i = 0; i < n_stages; i++) {
+      change = std::max(change, std::fabs(rhs[i] - z[i]));
+      z[i] = rhs[i];
     }
-    // If optimal design is finally found
-    else if ((neg_inc == true) and (machines_needed <= max_centrifuges)) {
-      optimal_feed = curr_feed;
-      optimal_number = true;
-    } else if ((pos_inc == true) and (machines_needed > max_centrifuges)) {
-      optimal_feed = last_feed;
-      optimal_number = true;
+    if (change < tol) {
+      break;
     }
-    feed_flows = CalcFeedFlows(n_stages, optimal_feed, cut);
-    stage_info = CalcStageFeatures(optimal_feed, design_alpha, design_delU, cut,
-                                   n_stages, feed_flows);
-    machines_needed = FindTotalMachines(stage_info);
   }
-  // Otherwise if there are enough centrifuges to process more than the
-  // requested amount of material
+  for (int i = 0; i < n_stages; i++) {
+    w[i] = StageTailsAssay(q, theta, z[i]);
+    y[i] = (z[i] - (1 - theta) * w[i]) / theta;
+  }
 
-  std::pair<int, double> cascade_info =
-      std::make_pair(machines_needed, optimal_feed);
-  return cascade_info;
+  *product_assay = y[n_stages - 1];
+  *tails_assay = w[0];
+
+  // separative work per unit feed of the whole cascade and of its stages.
+  // The value functions of every stage stream are evaluated in place.
+  CalcV(&y[0], &y[0], n_stages);
+  CalcV(&w[0], &w[0], n_stages);
+  CalcV(&z[0], &z[0], n_stages);
+  double cascade_dU = theta * unit_flow[n_stages - 1] * y[n_stages - 1] +
+                      (1 - theta) * unit_flow[0] * w[0] - CalcV(feed_assay);
+  double stage_dU = 0;
+  for (int i = 0; i < n_stages; i++) {
+    stage_dU += unit_flow[i] * (theta * y[i] + (1 - theta) * w[i] - z[i]);
+  }
+  *efficiency = (stage_dU > 0) ? cascade_dU / stage_dU : 0;
+}
+
+}  // namespace
+
+// The design flows come from the fixed-cut flow model, which is not exactly
+// matched to the ideal stage assays in the table. The stage balance is
+// therefore solved at both the design feed and the new feed, and the
+// change between the two is applied to the design (table) values: the
+// product and tails abundance ratios scale by the ratio of the solutions
+// and the efficiency is relative to the design point (1 at design).
+CascadePerformance SolveOffDesign(const StageTable& stages,
+                                  double feed_assay, double feed_flow) {
+  int n_stages = stages.size();
+  if ((n_stages == 0) || !(feed_assay > 0) || !(feed_assay < 1)) {
+    throw cyclus::ValueError("Off-design cascade needs stages and a feed "
+                             "assay between 0 and 1");
+  }
+
+  // flows for a unit cascade feed and the machine limited throughput (with
+  // the same tolerance used when counting machines)
+  double machine_tol = 0.01;
+  double machine_capacity =
+      2.0 * stages.del_U / pow(stages.alpha - 1.0, 2);
+  std::vector<double> unit_flow(n_stages);
+  double max_feed = std::numeric_limits<double>::max();
+  for (int i = 0; i < n_stages; i++) {
+    unit_flow[i] = stages.feed_flow[i] / stages.cascade_feed;
+    max_feed = std::min(max_feed, (stages.machines[i] + machine_tol) *
+                                      machine_capacity / unit_flow[i]);
+  }
+
+  double design_product, design_tails, design_eff;
+  StageBalance(stages, unit_flow, stages.feed_assay[stages.n_strip],
+               &design_product, &design_tails, &design_eff);
+  double product, tails, eff;
+  StageBalance(stages, unit_flow, feed_assay, &product, &tails, &eff);
+
+  CascadePerformance perf;
+  perf.feed_assay = feed_assay;
+  perf.product_assay =
+      AssayFromRatio(AbundanceRatio(stages.ProductAssay()) *
+                     AbundanceRatio(product) / AbundanceRatio(design_product));
+  perf.tails_assay =
+      AssayFromRatio(AbundanceRatio(stages.TailsAssay()) *
+                     AbundanceRatio(tails) / AbundanceRatio(design_tails));
+  perf.efficiency =
+      (design_eff > 0) ? std::max(0.0, std::min(1.0, eff / design_eff)) : 0;
+
+  // product and tails split of the throughput by U235 balance
+  perf.max_feed_flow = max_feed;
+  perf.feed_flow = std::min(feed_flow, max_feed);
+  perf.product_flow = perf.feed_flow * (feed_assay - perf.tails_assay) /
+                      (perf.product_assay - perf.tails_assay);
+  perf.tails_flow = perf.feed_flow - perf.product_flow;
+  return perf;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+namespace {
+typedef std::map<cyclus::Bid<cyclus::Material>*, double>::iterator BidPrefIt;
+
+bool LessU235(const std::pair<double, BidPrefIt>& i,
+              const std::pair<double, BidPrefIt>& j) {
+  return i.first < j.first;
+}
+}  // namespace
+
+void RankBidsByU235(std::map<cyclus::Bid<cyclus::Material>*, double>* bids) {
+  std::vector<std::pair<double, BidPrefIt> > ranked;
+  ranked.reserve(bids->size());
+  for (BidPrefIt it = bids->begin(); it != bids->end(); ++it) {
+    double frac = CompProps(it->first->offer()).u235_mass_frac;
+    ranked.push_back(std::make_pair(frac, it));
+  }
+  std::stable_sort(ranked.begin(), ranked.end(), LessU235);
+
+  for (int i = 0; i < ranked.size(); i++) {
+    ranked[i].second->second = (ranked[i].first > 0) ? i + 1 : -1;
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+UraniumTally::UraniumTally() : u235_(0), u238_(0), total_(0) {}
+
+void UraniumTally::Add(cyclus::Material::Ptr mat) {
+  CompProperties props = CompProps(mat);
+  u235_ += props.u235_mass_frac * mat->quantity();
+  u238_ += props.u238_mass_frac * mat->quantity();
+  total_ += mat->quantity();
+}
+
+void UraniumTally::Remove(cyclus::Material::Ptr mat) {
+  CompProperties props = CompProps(mat);
+  u235_ -= props.u235_mass_frac * mat->quantity();
+  u238_ -= props.u238_mass_frac * mat->quantity();
+  total_ -= mat->quantity();
+}
+
+void UraniumTally::Clear() {
+  u235_ = 0;
+  u238_ = 0;
+  total_ = 0;
+}
+
+// Masses are converted to atoms so that the assay matches UraniumAssay
+double UraniumTally::Assay() const {
+  double n235 = std::max(0.0, u235_) / pyne::atomic_mass(922350000);
+  double n238 = std::max(0.0, u238_) / pyne::atomic_mass(922380000);
+  if (n235 + n238 <= 0) {
+    return 0;
+  }
+  return n235 / (n235 + n238);
+}
+
+double UraniumTally::UraniumFraction() const {
+  if (total_ <= 0) {
+    return 0;
+  }
+  return std::max(0.0, u235_ + u238_) / total_;
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-bool SortBids(cyclus::Bid<cyclus::Material>* i,
-              cyclus::Bid<cyclus::Material>* j) {
-  cyclus::Material::Ptr mat_i = i->offer();
-  cyclus::Material::Ptr mat_j = j->offer();
+cyclus::Material::Ptr WithdrawFeed(
+    cyclus::toolkit::ResBuf<cyclus::Material>* inventory, UraniumTally* tally,
+    double qty) {
+  // required so popping doesn't take out too much
+  if (cyclus::AlmostEq(qty, inventory->quantity())) {
+    qty = inventory->quantity();
+  }
+  cyclus::Material::Ptr feed = inventory->Pop(qty, cyclus::eps_rsrc());
+
+  if (inventory->empty()) {
+    tally->Clear();
+  } else {
+    tally->Remove(feed);
+  }
+  return feed;
+}
 
-  cyclus::toolkit::MatQuery mq_i(mat_i);
-  cyclus::toolkit::MatQuery mq_j(mat_j);
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+int ConsolidateLots(cyclus::toolkit::ResBuf<cyclus::Material>* buf,
+                    double bin_width) {
+  using cyclus::Material;
 
-  return ((mq_i.mass(922350000) / mq_i.qty()) <=
-          (mq_j.mass(922350000) / mq_j.qty()));
+  if (buf->count() < 2) {
+    return buf->count();
+  }
+  std::vector<Material::Ptr> lots = buf->PopN(buf->count());
+  std::vector<Material::Ptr> merged;
+  std::map<double, int> bin_lot;
+  for (int i = 0; i < lots.size(); i++) {
+    double assay = CompProps(lots[i]).assay;
+    double bin = (bin_width > 0) ? std::floor(assay / bin_width) : assay;
+    std::map<double, int>::iterator it = bin_lot.find(bin);
+    if (it == bin_lot.end()) {
+      bin_lot[bin] = merged.size();
+      merged.push_back(lots[i]);
+    } else {
+      merged[it->second]->Absorb(lots[i]);
+    }
+  }
+  buf->Push(merged);
+  return buf->count();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TradeSummary::TradeSummary() {
+  Clear();
+}
+
+void TradeSummary::Add(double natural_u, double swu) {
+  if (n_trades_ == 0) {
+    natu_min_ = natu_max_ = natural_u;
+    swu_min_ = swu_max_ = swu;
+  } else {
+    natu_min_ = std::min(natu_min_, natural_u);
+    natu_max_ = std::max(natu_max_, natural_u);
+    swu_min_ = std::min(swu_min_, swu);
+    swu_max_ = std::max(swu_max_, swu);
+  }
+  natu_sum_ += natural_u;
+  swu_sum_ += swu;
+  n_trades_++;
+}
+
+void TradeSummary::Clear() {
+  n_trades_ = 0;
+  natu_sum_ = 0;
+  natu_min_ = 0;
+  natu_max_ = 0;
+  swu_sum_ = 0;
+  swu_min_ = 0;
+  swu_max_ = 0;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool SummaryDue(int time, int record_interval, int duration) {
+  return ((time + 1) % record_interval == 0) || (time >= duration - 1);
 }
 
 }  // namespace mbmore
@@ -1,6 +1,8 @@
 #ifndef MBMORE_SRC_ENRICH_FUNCTIONS_H_
 #define MBMORE_SRC_ENRICH_FUNCTIONS_H_
 
+#include <algorithm>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -8,15 +10,94 @@
 
 namespace mbmore {
 
-// LAPACK solver for system of linear equations
+// LAPACK solver for tridiagonal system of linear equations
 extern "C" {
-     void dgesv_(int *n, int *nrhs,  double *a,  int  *lda,  
-           int *ipivot, double *b, int *ldb, int *info) ;
+     void dgtsv_(int *n, int *nrhs, double *dl, double *d, double *du,
+           double *b, int *ldb, int *info) ;
 }
 
-  // Organizes bids by enrichment level of requested material
-  bool SortBids(cyclus::Bid<cyclus::Material>* i,
-		cyclus::Bid<cyclus::Material>* j);
+  // Sets the preference of each bid to its rank by the U235 mass fraction
+  // of its offer (1 for the lowest), or to -1 if the offer has no U235.
+  // Each fraction is computed once, and equal fractions keep their order.
+  void RankBidsByU235(std::map<cyclus::Bid<cyclus::Material>*, double>* bids);
+
+  // Running U235 and U238 content of a feed inventory, updated as material
+  // is pushed and popped, so the inventory assay can be read without
+  // combining the inventory into one material
+  class UraniumTally {
+   public:
+    UraniumTally();
+
+    void Add(cyclus::Material::Ptr mat);
+    void Remove(cyclus::Material::Ptr mat);
+    void Clear();
+
+    // U235 atom fraction of the uranium (as toolkit::UraniumAssay), 0 if
+    // there is no uranium
+    double Assay() const;
+
+    // mass fraction of U235 + U238 in the tallied material
+    double UraniumFraction() const;
+
+    double quantity() const { return std::max(0.0, total_); }
+
+   private:
+    double u235_;
+    double u238_;
+    double total_;
+  };
+
+  // Pops qty of feed from inventory in a single pass over its lots (only the
+  // last lot taken is split) and removes it from the tally that tracks the
+  // inventory. A request within rounding of the whole inventory takes all of
+  // it. Throws cyclus::ValueError if qty exceeds the inventory.
+  cyclus::Material::Ptr WithdrawFeed(
+      cyclus::toolkit::ResBuf<cyclus::Material>* inventory,
+      UraniumTally* tally, double qty);
+
+  // Merges the lots of buf whose U235 assays (as toolkit::UraniumAssay) fall
+  // in the same bin of width bin_width (identical assays only if bin_width
+  // is not positive). Lots are combined with Material::Absorb, so mass and
+  // isotopics are conserved, and the merged lots keep the order in which
+  // their bins first appear. Returns the number of lots left in buf.
+  int ConsolidateLots(cyclus::toolkit::ResBuf<cyclus::Material>* buf,
+                      double bin_width);
+
+  // Count, sum, minimum and maximum of the natural uranium and SWU of the
+  // trades made since the last Clear, so that a run of trades can be
+  // recorded as a single row
+  class TradeSummary {
+   public:
+    TradeSummary();
+
+    void Add(double natural_u, double swu);
+
+    void Clear();
+
+    int n_trades() const { return n_trades_; }
+    bool empty() const { return n_trades_ == 0; }
+
+    double natu_sum() const { return natu_sum_; }
+    double natu_min() const { return natu_min_; }
+    double natu_max() const { return natu_max_; }
+    double swu_sum() const { return swu_sum_; }
+    double swu_min() const { return swu_min_; }
+    double swu_max() const { return swu_max_; }
+
+   private:
+    int n_trades_;
+    double natu_sum_;
+    double natu_min_;
+    double natu_max_;
+    double swu_sum_;
+    double swu_min_;
+    double swu_max_;
+  };
+
+  // True if a summary over record_interval timesteps is complete at the end
+  // of timestep time. Intervals start at time 0, and the last timestep of
+  // the simulation (duration - 1) completes the last, possibly short, one.
+  bool SummaryDue(int time, int record_interval, int duration);
 
   
   // Calculates the ideal separation energy for a single machine 
@@ -50,7 +131,8 @@ extern "C" {
   double WasteAssayByAlpha(double alpha, double feed_assay);
 
   // Calculates the number of stages needed in a cascade given the separation
-  // potential of a single centrifuge and the material assays
+  // potential of a single centrifuge and the material assays. Throws a
+  // ValueError unless 0 < Nwc < feed_assay < product_assay < 1.
   std::pair<int, int>
     FindNStages(double alpha, double feed_assay, double product_assay,
 		     double Nwc);
@@ -63,6 +145,20 @@ extern "C" {
   double WasteAssayFromNStages(double alpha, double feed_assay,
 			       double strip_stages);
 
+  // Batch version of CalcV: evaluates element i of the n-long assay array
+  // into element i of v (which may alias assay). An AVX2 path is used when
+  // the CPU supports it, otherwise a scalar loop; both give results
+  // identical to the scalar function.
+  void CalcV(const double* assay, double* v, int n);
+
+  // Allows (default) or disables the SIMD path of the batch CalcV. The
+  // setting is process-wide but safe to change while other threads run
+  // it (each call uses the setting it reads on entry).
+  void UseSimdBatchKernels(bool use_simd);
+
+  // True if the batch CalcV is currently using the SIMD path
+  bool SimdBatchKernels();
+
   // Number of machines in a stage (either enrich or strip)
   // given the feed flow (stage_feed)
   // flows do not have required units so long as they are consistent
@@ -102,11 +198,15 @@ extern "C" {
 			     double product_flow, double waste_flow,
 			     double feed_assay);
 
-  // Solves system of linear eqns to determine steady state flow rates
-  // in each stage of cascade
+  // Solves tridiagonal system of linear eqns to determine steady state flow
+  // rates in each stage of cascade (no limit on the number of stages)
   std::vector<double> CalcFeedFlows(std::pair<int, int> n_st,
 				    double cascade_feed, double cut);
 
+  // Number of whole machines for a stage given the ideal (fractional) number.
+  // Rounds up unless the ideal number is within 0.01 of an integer.
+  int IntegerMachines(double n_mach_exact);
+
   // Determines the number of machines and product in each stage based
   // on the steady-state flows defined for the cascade.
   std::vector<std::pair<int, double>> CalcStageFeatures(double feed_assay,
@@ -118,12 +218,89 @@ extern "C" {
   // Determine total number of machines in the cascade from machines per stage
   int FindTotalMachines(std::vector<std::pair<int, double>> stage_info);
 
+  // Cascade that fits within the available centrifuges
+  struct CascadeSize {
+    int n_machines;       // machines used by the cascade
+    double feed_flow;     // cascade feed (same units as machine feed)
+    int unused_machines;  // available machines left unused
+  };
+
+  // Total machines for a cascade feed, given the ideal machines per stage
+  // for a unit cascade feed. Optionally reports the smallest stage.
+  int MachinesForFeed(const std::vector<double>& unit_machines,
+		      double cascade_feed, int* min_stage_machines);
+
+  // Finds the largest cascade feed that can be processed with at most
+  // max_centrifuges machines (bracket and bisect on integer machine counts).
+  // With no centrifuges the cascade is empty (no machines and no feed).
+  CascadeSize SizeCascade(double alpha, double del_U, double cut,
+			  int max_centrifuges, std::pair<int, int> n_stages);
+
+  // Number of machines and cascade feed using as many of the available
+  // centrifuges as possible (design_feed is retained for compatibility)
   std::pair<int,double> DesignCascade( double design_feed, double design_alpha,
 				       double design_delU, double cut,
 				       int max_centrifuges,
 				       std::pair<int,int> n_stages);
 
-  
+
+  // Steady-state configuration of every stage of a cascade, stored as
+  // parallel arrays indexed from the last stripping stage (0) to the last
+  // enriching stage (size()-1). The cascade feed enters stage n_strip.
+  // Flows are in the units of the cascade feed.
+  struct StageTable {
+    std::vector<int> machines;
+    std::vector<double> feed_flow;
+    std::vector<double> product_flow;
+    std::vector<double> tails_flow;
+    std::vector<double> feed_assay;
+    std::vector<double> product_assay;
+    std::vector<double> tails_assay;
+
+    int n_strip;
+    double cascade_feed;
+    double alpha;
+    double del_U;
+    double cut;
+
+    int size() const { return machines.size(); }
+    bool empty() const { return machines.empty(); }
+    int TotalMachines() const;
+
+    // Cascade product (top stage) and tails (bottom stage) assays
+    double ProductAssay() const { return product_assay.back(); }
+    double TailsAssay() const { return tails_assay.front(); }
+  };
+
+  // Builds the stage table for an ideal cascade with the given stages and
+  // cascade feed
+  StageTable BuildStageTable(double feed_assay, double alpha, double del_U,
+			     double cut, std::pair<int, int> n_st,
+			     double cascade_feed);
+
+  // Actual operation of a built cascade fed off its design point
+  struct CascadePerformance {
+    double feed_assay;
+    double product_assay;
+    double tails_assay;
+    // flows through the cascade (same units as the table's cascade feed)
+    double feed_flow;
+    double product_flow;
+    double tails_flow;
+    // largest cascade feed the machines in every stage can take
+    double max_feed_flow;
+    // separative work delivered by the cascade divided by the separative
+    // work done in its stages (1 for an ideal cascade, less when streams of
+    // different assay are mixed between stages)
+    double efficiency;
+  };
+
+  // Solves the stage by stage U235 balance of the cascade in the table with
+  // the stage cuts and machine layout held fixed, for a new feed assay and
+  // requested cascade feed flow (capped by the machine capacity).
+  CascadePerformance SolveOffDesign(const StageTable& stages,
+				    double feed_assay, double feed_flow);
+
 } // namespace mbmore
 
 #endif  //  MBMORE_SRC_ENRICH_FUNCTIONS_H_
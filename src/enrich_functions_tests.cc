@@ -45,6 +45,34 @@ namespace mbmore {
     const double tol_qty = 1e-6;
     const double tol_num = 1e-2;
    
+    // Stage by stage stage count (the original FindNStages) used as the
+    // reference for the analytic version
+    std::pair<int, int> IterativeNStages(double alpha, double feed_assay,
+					 double product_assay,
+					 double waste_assay) {
+      int ideal_enrich_stage = 0;
+      int ideal_strip_stage = 0;
+      double stage_feed_assay = feed_assay;
+      double stage_product_assay = feed_assay;
+      double stage_waste_assay = feed_assay;
+
+      while (stage_product_assay < product_assay) {
+	stage_product_assay = ProductAssayByAlpha(alpha, stage_feed_assay);
+	if (ideal_enrich_stage == 0) {
+	  stage_waste_assay = WasteAssayByAlpha(alpha, stage_feed_assay);
+	}
+	ideal_enrich_stage += 1;
+	stage_feed_assay = stage_product_assay;
+      }
+      stage_feed_assay = stage_waste_assay;
+      while (stage_waste_assay > waste_assay) {
+	stage_waste_assay = WasteAssayByAlpha(alpha, stage_feed_assay);
+	ideal_strip_stage += 1;
+	stage_feed_assay = stage_waste_assay;
+      }
+      return std::make_pair(ideal_enrich_stage, ideal_strip_stage);
+    }
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 // Find product assay from separation factor alpha
 TEST(Enrich_Functions_Test, TestAssays) {
@@ -194,29 +222,391 @@ TEST(Enrich_Functions_Test, TestCascadeDesign) {
   }
 
   // not enough machines
+  // (cascade is sized exactly to the available machines)
   int max_centrifuges = 80;
   std::pair<int, double> design_params = DesignCascade(feed_c, alpha, delU,
 						       cut, max_centrifuges,
 						       n_stages);
-  int py_tot_mach = 79;
-  double py_opt_feed = 1.30116169899e-05;
+  int expected_machines = 80;
+  double expected_feed = 1.33221e-05;
   
-  EXPECT_EQ(py_tot_mach, design_params.first);
-  EXPECT_NEAR(py_opt_feed, design_params.second, tol_qty);
+  EXPECT_EQ(expected_machines, design_params.first);
+  EXPECT_NEAR(expected_feed, design_params.second, tol_qty);
   
   // more machines than requested capacity
   max_centrifuges = 1000;
   design_params = DesignCascade(feed_c, alpha, delU,
 				cut, max_centrifuges,
 				n_stages);
-  py_tot_mach = 986;
-  py_opt_feed = 0.000172728;
+  expected_machines = 1000;
+  expected_feed = 0.000175218;
   
-  EXPECT_EQ(py_tot_mach, design_params.first);
-  EXPECT_NEAR(py_opt_feed, design_params.second, tol_qty);
+  EXPECT_EQ(expected_machines, design_params.first);
+  EXPECT_NEAR(expected_feed, design_params.second, tol_qty);
   
 }
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Cascade sizing is exact at the max_centrifuges boundary: the chosen feed
+// fits within the available machines and any larger feed does not.
+TEST(Enrich_Functions_Test, TestSizeCascade) {
+  std::pair<int, int> n_stages = FindNStages(alpha, 0.10, 0.20, 0.05);
+
+  int max_centrifuges = 25000;
+  CascadeSize size = SizeCascade(alpha, delU, cut, max_centrifuges, n_stages);
+  EXPECT_LE(size.n_machines, max_centrifuges);
+  EXPECT_EQ(size.n_machines + size.unused_machines, max_centrifuges);
+
+  std::vector<double> flows = CalcFeedFlows(n_stages, size.feed_flow, cut);
+  int n_mach = FindTotalMachines(
+      CalcStageFeatures(0.10, alpha, delU, cut, n_stages, flows));
+  EXPECT_EQ(n_mach, size.n_machines);
+
+  flows = CalcFeedFlows(n_stages, size.feed_flow * (1 + 1e-9), cut);
+  n_mach = FindTotalMachines(
+      CalcStageFeatures(0.10, alpha, delU, cut, n_stages, flows));
+  EXPECT_GT(n_mach, max_centrifuges);
+
+  // fewer machines than stages cannot make the target enrichment
+  EXPECT_THROW(SizeCascade(alpha, delU, cut, 5, n_stages), cyclus::ValueError);
+  EXPECT_THROW(SizeCascade(alpha, delU, cut, -1, n_stages),
+               cyclus::ValueError);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// With no centrifuges (the max_centrifuges default) there is no cascade
+TEST(Enrich_Functions_Test, TestSizeCascadeNoMachines) {
+  std::pair<int, int> n_stages = FindNStages(alpha, 0.10, 0.20, 0.05);
+
+  CascadeSize size = SizeCascade(alpha, delU, cut, 0, n_stages);
+  EXPECT_EQ(0, size.n_machines);
+  EXPECT_DOUBLE_EQ(0, size.feed_flow);
+  EXPECT_EQ(0, size.unused_machines);
+
+  std::pair<int, double> design_params =
+      DesignCascade(0, alpha, delU, cut, 0, n_stages);
+  EXPECT_EQ(0, design_params.first);
+  EXPECT_DOUBLE_EQ(0, design_params.second);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Steady state flows for a cascade longer than the old 100 stage limit
+// must still balance in every stage and conserve the cascade feed
+TEST(Enrich_Functions_Test, TestFeedFlowsManyStages) {
+  std::pair<int, int> n_stages = std::make_pair(90, 80);
+  int n_tot = n_stages.first + n_stages.second;
+  std::vector<double> flows = CalcFeedFlows(n_stages, feed_c, cut);
+  double tol_flow = feed_c * 1e-9;
+
+  ASSERT_EQ(flows.size(), n_tot);
+  for (int i = 0; i < n_tot; i++) {
+    double in_flow = 0;
+    if (i > 0) {
+      in_flow += cut * flows[i - 1];
+    }
+    if (i < n_tot - 1) {
+      in_flow += (1 - cut) * flows[i + 1];
+    }
+    if (i == n_stages.second) {
+      in_flow += feed_c;
+    }
+    EXPECT_NEAR(flows[i], in_flow, tol_flow);
+  }
+  double out_flow = cut * flows[n_tot - 1] + (1 - cut) * flows[0];
+  EXPECT_NEAR(out_flow, feed_c, tol_flow);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Batch CalcV gives exactly the scalar results on both the SIMD and scalar
+// paths (including a remainder that is not a multiple of 4 and in place),
+// so the off-design stage balance does not depend on the path
+TEST(Enrich_Functions_Test, TestBatchCalcV) {
+  int n = 103;
+  std::vector<double> assays(n);
+  for (int i = 0; i < n; i++) {
+    assays[i] = 0.001 + 0.9 * i / n;
+  }
+  std::pair<int, int> n_stages = FindNStages(alpha, feed_assay, product_assay,
+					     waste_assay);
+  CascadeSize size = SizeCascade(alpha, delU, cut, 1000, n_stages);
+  StageTable stages = BuildStageTable(feed_assay, alpha, delU, cut, n_stages,
+				      size.feed_flow);
+
+  bool paths[] = {true, false};
+  CascadePerformance perf[2];
+  for (int p = 0; p < 2; p++) {
+    UseSimdBatchKernels(paths[p]);
+    std::vector<double> v(n);
+    CalcV(&assays[0], &v[0], n);
+    std::vector<double> in_place(assays);
+    CalcV(&in_place[0], &in_place[0], n);
+    for (int i = 0; i < n; i++) {
+      EXPECT_EQ(v[i], CalcV(assays[i]));
+      EXPECT_EQ(in_place[i], v[i]);
+    }
+    perf[p] = SolveOffDesign(stages, 0.0035, size.feed_flow);
+  }
+  UseSimdBatchKernels(true);
+  EXPECT_EQ(perf[0].product_assay, perf[1].product_assay);
+  EXPECT_EQ(perf[0].tails_assay, perf[1].tails_assay);
+  EXPECT_EQ(perf[0].efficiency, perf[1].efficiency);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Analytic stage counts match the stage by stage calculation over a dense
+// grid of separation factors and assays (including alpha close to 1 and
+// HEU targets)
+TEST(Enrich_Functions_Test, TestNStagesGrid) {
+  int n_mismatch = 0;
+  for (int ia = 0; ia < 40; ia++) {
+    double cur_alpha = 1.005 + 0.03 * ia;
+    for (int ifeed = 0; ifeed < 12; ifeed++) {
+      double fa = 0.002 + 0.0173 * ifeed;
+      for (int ip = 1; ip <= 12; ip++) {
+	double pa = fa + (0.95 - fa) * ip / 12.0;
+	for (int iw = 0; iw < 8; iw++) {
+	  double wa = 0.0001 + (fa - 0.0001) * iw / 8.0;
+	  std::pair<int, int> analytic = FindNStages(cur_alpha, fa, pa, wa);
+	  std::pair<int, int> iterative = IterativeNStages(cur_alpha, fa, pa,
+							   wa);
+	  if (analytic != iterative) {
+	    n_mismatch++;
+	    ADD_FAILURE() << "alpha " << cur_alpha << " feed " << fa
+			  << " product " << pa << " waste " << wa
+			  << ": analytic (" << analytic.first << ", "
+			  << analytic.second << ") iterative ("
+			  << iterative.first << ", " << iterative.second << ")";
+	  }
+	}
+      }
+    }
+  }
+  EXPECT_EQ(n_mismatch, 0);
+
+  EXPECT_THROW(FindNStages(1.0, feed_assay, product_assay, waste_assay),
+	       cyclus::ValueError);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Assays at 0 or 1, or out of order, have no finite stage count
+TEST(Enrich_Functions_Test, TestNStagesInvalidAssays) {
+  double bad[][3] = {{0.0, 0.035, 0.003},  {0.0071, 1.0, 0.003},
+		     {0.0071, 0.035, 0.0}, {0.0071, 0.035, -0.001},
+		     {1.0, 1.0, 0.003},    {0.05, 0.05, 0.01},
+		     {0.05, 0.035, 0.003}, {0.0071, 0.035, 0.0071},
+		     {0.0071, 0.035, 0.01}};
+  for (int i = 0; i < 9; i++) {
+    EXPECT_THROW(FindNStages(alpha, bad[i][0], bad[i][1], bad[i][2]),
+		 cyclus::ValueError)
+	<< "feed " << bad[i][0] << " product " << bad[i][1] << " waste "
+	<< bad[i][2];
+  }
+  EXPECT_NO_THROW(FindNStages(alpha, 0.0071, 0.035, 0.003));
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Stage table matches the cascade sizing and the ideal stage assays
+TEST(Enrich_Functions_Test, TestStageTable) {
+  std::pair<int, int> n_stages = FindNStages(alpha, feed_assay, product_assay,
+					     waste_assay);
+  int max_centrifuges = 1000;
+  CascadeSize size = SizeCascade(alpha, delU, cut, max_centrifuges, n_stages);
+  StageTable stages = BuildStageTable(feed_assay, alpha, delU, cut, n_stages,
+				      size.feed_flow);
+
+  EXPECT_EQ(stages.size(), n_stages.first + n_stages.second);
+  EXPECT_EQ(stages.n_strip, n_stages.second);
+  EXPECT_EQ(stages.TotalMachines(), size.n_machines);
+  EXPECT_NEAR(stages.feed_assay[stages.n_strip], feed_assay, tol_assay);
+  EXPECT_GE(stages.ProductAssay(), product_assay);
+  EXPECT_LE(stages.TailsAssay(), waste_assay);
+  for (int i = 0; i < stages.size(); i++) {
+    EXPECT_NEAR(stages.product_flow[i] + stages.tails_flow[i],
+		stages.feed_flow[i], tol_qty);
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Off-design solution of a built cascade conserves flow and U235, matches
+// the stage table at the design feed and loses product assay and
+// efficiency away from it
+TEST(Enrich_Functions_Test, TestOffDesign) {
+  std::pair<int, int> n_stages = FindNStages(alpha, feed_assay, product_assay,
+					     waste_assay);
+  CascadeSize size = SizeCascade(alpha, delU, cut, 1000, n_stages);
+  StageTable stages = BuildStageTable(feed_assay, alpha, delU, cut, n_stages,
+				      size.feed_flow);
+
+  CascadePerformance design = SolveOffDesign(stages, feed_assay,
+					     size.feed_flow);
+  EXPECT_NEAR(design.feed_flow, size.feed_flow, tol_qty);
+  EXPECT_GE(design.max_feed_flow, size.feed_flow);
+  EXPECT_NEAR(design.product_flow + design.tails_flow, design.feed_flow,
+	      tol_qty);
+  EXPECT_NEAR(design.product_flow * design.product_assay +
+	      design.tails_flow * design.tails_assay,
+	      design.feed_flow * feed_assay, tol_qty);
+  EXPECT_NEAR(design.product_assay, stages.ProductAssay(), tol_assay);
+  EXPECT_NEAR(design.tails_assay, stages.TailsAssay(), tol_assay);
+  EXPECT_NEAR(design.efficiency, 1.0, 1e-9);
+
+  // throughput is capped by the machines
+  CascadePerformance capped = SolveOffDesign(stages, feed_assay,
+					     10 * size.feed_flow);
+  EXPECT_NEAR(capped.feed_flow, design.max_feed_flow, tol_qty);
+
+  // depleted feed
+  double low_feed = 0.0035;
+  CascadePerformance low = SolveOffDesign(stages, low_feed, size.feed_flow);
+  EXPECT_LT(low.product_assay, design.product_assay);
+  EXPECT_LT(low.tails_assay, design.tails_assay);
+  EXPECT_LT(low.efficiency, design.efficiency);
+  EXPECT_NEAR(low.product_flow * low.product_assay +
+	      low.tails_flow * low.tails_assay,
+	      low.feed_flow * low_feed, tol_qty);
+
+  EXPECT_THROW(SolveOffDesign(stages, 0, size.feed_flow), cyclus::ValueError);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Running inventory tally gives the same assay as combining the inventory
+// into one material, including after material is removed
+TEST(Enrich_Functions_Test, TestUraniumTally) {
+  using cyclus::Composition;
+  using cyclus::Material;
+  using cyclus::toolkit::UraniumAssay;
+
+  cyclus::CompMap nat;
+  nat[922350000] = 0.0071;
+  nat[922380000] = 0.9929;
+  cyclus::CompMap leu;
+  leu[922350000] = 0.04;
+  leu[922380000] = 0.86;
+  leu[80160000] = 0.10;
+  Composition::Ptr nat_comp = Composition::CreateFromMass(nat);
+  Composition::Ptr leu_comp = Composition::CreateFromMass(leu);
+
+  UraniumTally tally;
+  EXPECT_EQ(tally.Assay(), 0);
+  tally.Add(Material::CreateUntracked(100, nat_comp));
+  tally.Add(Material::CreateUntracked(20, leu_comp));
+
+  Material::Ptr combined = Material::CreateUntracked(100, nat_comp);
+  combined->Absorb(Material::CreateUntracked(20, leu_comp));
+  EXPECT_NEAR(tally.Assay(), UraniumAssay(combined), 1e-12);
+  EXPECT_NEAR(tally.quantity(), 120, tol_qty);
+  EXPECT_NEAR(tally.UraniumFraction(), (100 + 20 * 0.9) / 120, 1e-12);
+
+  tally.Remove(Material::CreateUntracked(20, leu_comp));
+  EXPECT_NEAR(tally.Assay(),
+	      UraniumAssay(Material::CreateUntracked(100, nat_comp)), 1e-12);
+  EXPECT_NEAR(tally.UraniumFraction(), 1.0, 1e-12);
+
+  tally.Clear();
+  EXPECT_EQ(tally.quantity(), 0);
+  EXPECT_EQ(tally.UraniumFraction(), 0);
+}
+
+// Withdrawal takes lots in order, splits only the last one, and keeps the
+// tally in step with the inventory
+TEST(Enrich_Functions_Test, TestWithdrawFeed) {
+  using cyclus::Composition;
+  using cyclus::Material;
+
+  cyclus::CompMap nat;
+  nat[922350000] = 0.0071;
+  nat[922380000] = 0.9929;
+  Composition::Ptr nat_comp = Composition::CreateFromMass(nat);
+
+  cyclus::toolkit::ResBuf<Material> inventory;
+  UraniumTally tally;
+  for (int i = 0; i < 3; i++) {
+    Material::Ptr lot = Material::CreateUntracked(10, nat_comp);
+    inventory.Push(lot);
+    tally.Add(lot);
+  }
+
+  Material::Ptr feed = WithdrawFeed(&inventory, &tally, 15);
+  EXPECT_NEAR(feed->quantity(), 15, tol_qty);
+  EXPECT_EQ(inventory.count(), 2);
+  EXPECT_NEAR(inventory.quantity(), 15, tol_qty);
+  EXPECT_NEAR(tally.quantity(), 15, tol_qty);
+
+  // a request within rounding of the remainder empties the inventory
+  feed = WithdrawFeed(&inventory, &tally, 15 * (1 + 1e-10));
+  EXPECT_NEAR(feed->quantity(), 15, tol_qty);
+  EXPECT_TRUE(inventory.empty());
+  EXPECT_EQ(tally.quantity(), 0);
+
+  EXPECT_THROW(WithdrawFeed(&inventory, &tally, 1), cyclus::ValueError);
+}
+
+// Lots in the same assay bin are merged without changing the buffer totals
+TEST(Enrich_Functions_Test, TestConsolidateLots) {
+  using cyclus::Composition;
+  using cyclus::Material;
+  using cyclus::toolkit::MatQuery;
+
+  double assays[] = {0.0030, 0.0031, 0.0020, 0.00305, 0.0021};
+  cyclus::toolkit::ResBuf<Material> tails;
+  double u235 = 0;
+  for (int i = 0; i < 5; i++) {
+    cyclus::CompMap comp;
+    comp[922350000] = assays[i];
+    comp[922380000] = 1 - assays[i];
+    Material::Ptr lot =
+        Material::CreateUntracked(i + 1, Composition::CreateFromMass(comp));
+    u235 += MatQuery(lot).mass(922350000);
+    tails.Push(lot);
+  }
+
+  EXPECT_EQ(ConsolidateLots(&tails, 0.001), 2);
+  EXPECT_NEAR(tails.quantity(), 15, tol_qty);
+
+  std::vector<Material::Ptr> lots = tails.PopN(tails.count());
+  EXPECT_NEAR(lots[0]->quantity(), 1 + 2 + 4, tol_qty);
+  EXPECT_NEAR(lots[1]->quantity(), 3 + 5, tol_qty);
+  EXPECT_NEAR(MatQuery(lots[0]).mass(922350000) +
+              MatQuery(lots[1]).mass(922350000), u235, 1e-12);
+
+  // nothing further to merge when every lot is in its own bin
+  tails.Push(lots);
+  EXPECT_EQ(ConsolidateLots(&tails, 0.0001), 2);
+}
   
-  
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Summaries total the trades added since they were cleared, and are due at
+// the end of each interval and at the end of the simulation
+TEST(Enrich_Functions_Test, TestTradeSummary) {
+  TradeSummary summary;
+  EXPECT_TRUE(summary.empty());
+
+  summary.Clear();
+  summary.Add(10, 2);
+  summary.Add(4, 5);
+  summary.Add(7, 1);
+  EXPECT_EQ(summary.n_trades(), 3);
+  EXPECT_DOUBLE_EQ(summary.natu_sum(), 21);
+  EXPECT_DOUBLE_EQ(summary.natu_min(), 4);
+  EXPECT_DOUBLE_EQ(summary.natu_max(), 10);
+  EXPECT_DOUBLE_EQ(summary.swu_sum(), 8);
+  EXPECT_DOUBLE_EQ(summary.swu_min(), 1);
+  EXPECT_DOUBLE_EQ(summary.swu_max(), 5);
+
+  summary.Clear();
+  EXPECT_TRUE(summary.empty());
+  EXPECT_EQ(summary.natu_sum(), 0);
+
+  // per timestep
+  EXPECT_TRUE(SummaryDue(4, 1, 100));
+  // every 5 timesteps (0-4, 5-9, ...)
+  EXPECT_FALSE(SummaryDue(13, 5, 100));
+  EXPECT_TRUE(SummaryDue(14, 5, 100));
+  // end of simulation
+  EXPECT_FALSE(SummaryDue(97, 5, 99));
+  EXPECT_TRUE(SummaryDue(98, 5, 99));
+}
+
   } // namespace enrichfunctiontests
+
 } // namespace mbmore
\ No newline at end of file
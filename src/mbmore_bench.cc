@@ -0,0 +1,210 @@
+// Microbenchmarks for the cascade design (enrich_functions) and behavior
+// (behavior_functions) helpers.
+//
+// Run the mbmore_bench_json target (or mbmore_bench with
+// --benchmark_out=<file> --benchmark_out_format=json) to get results that
+// can be compared between commits, e.g. with benchmark's compare.py.
+
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "behavior_functions.h"
+#include "enrich_functions.h"
+
+namespace mbmore {
+namespace {
+
+// Cascade and machine parameters of the enrich_functions tests
+const double M = 0.352;
+const double dM = 0.003;
+const double x = 1000;
+const double flow_internal = 2.0;
+const double eff = 1.0;
+const double cut = 0.5;
+const double v_a = 485;
+const double height = 0.5;
+const double diameter = 0.15;
+const double machine_feed = 15 * 60 * 60 / ((1e3) * 60 * 60 * 1000.0);
+const double temp = 320.0;
+const double feed_assay = 0.0071;
+const double cascade_feed = 739 / (30.4 * 24 * 60 * 60);
+
+double DelU() {
+  return CalcDelU(v_a, height, diameter, machine_feed, temp, cut, eff, M, dM,
+                  x, flow_internal);
+}
+
+double Alpha() {
+  return AlphaBySwu(DelU(), machine_feed, cut, M);
+}
+
+// Stage layout with n_stages in total, one third of them stripping
+std::pair<int, int> Stages(int n_stages) {
+  int n_strip = n_stages / 3;
+  return std::make_pair(n_stages - n_strip, n_strip);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void BM_CalcDelU(benchmark::State& state) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(CalcDelU(v_a, height, diameter, machine_feed,
+                                      temp, cut, eff, M, dM, x,
+                                      flow_internal));
+  }
+}
+BENCHMARK(BM_CalcDelU);
+
+// Product assay chosen to need state.range(0) enriching stages
+void BM_FindNStages(benchmark::State& state) {
+  double alpha = Alpha();
+  double ratio = feed_assay / (1 - feed_assay) * pow(alpha, state.range(0));
+  double product_assay = std::min(ratio / (1 + ratio), 0.999);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        FindNStages(alpha, feed_assay, product_assay, 0.001));
+  }
+}
+BENCHMARK(BM_FindNStages)->RangeMultiplier(4)->Range(4, 256);
+
+void BM_CalcFeedFlows(benchmark::State& state) {
+  std::pair<int, int> n_stages = Stages(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(CalcFeedFlows(n_stages, cascade_feed, cut));
+  }
+  state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_CalcFeedFlows)->RangeMultiplier(4)->Range(8, 2048)->Complexity();
+
+void BM_CalcStageFeatures(benchmark::State& state) {
+  double alpha = Alpha();
+  double del_U = DelU();
+  std::pair<int, int> n_stages = Stages(state.range(0));
+  std::vector<double> flows = CalcFeedFlows(n_stages, cascade_feed, cut);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(CalcStageFeatures(feed_assay, alpha, del_U, cut,
+                                               n_stages, flows));
+  }
+  state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_CalcStageFeatures)
+    ->RangeMultiplier(4)
+    ->Range(8, 2048)
+    ->Complexity();
+
+// Arguments are (total stages, max centrifuges)
+void BM_DesignCascade(benchmark::State& state) {
+  double alpha = Alpha();
+  double del_U = DelU();
+  std::pair<int, int> n_stages = Stages(state.range(0));
+  int max_centrifuges = state.range(1);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(DesignCascade(cascade_feed, alpha, del_U, cut,
+                                           max_centrifuges, n_stages));
+  }
+}
+void DesignCascadeArgs(benchmark::internal::Benchmark* b) {
+  int stages[] = {8, 32, 128};
+  int machines[] = {1000, 100000, 10000000};
+  for (int s = 0; s < 3; s++) {
+    for (int m = 0; m < 3; m++) {
+      b->Args({stages[s], machines[m]});
+    }
+  }
+}
+BENCHMARK(BM_DesignCascade)->Apply(DesignCascadeArgs);
+
+// Off-design solution of a built cascade. Arguments are (total stages,
+// SIMD batch CalcV on/off)
+void BM_SolveOffDesign(benchmark::State& state) {
+  double alpha = Alpha();
+  double del_U = DelU();
+  StageTable stages = BuildStageTable(feed_assay, alpha, del_U, cut,
+                                      Stages(state.range(0)), cascade_feed);
+  UseSimdBatchKernels(state.range(1) != 0);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(SolveOffDesign(stages, 0.005, cascade_feed));
+  }
+  UseSimdBatchKernels(true);
+  state.SetLabel(state.range(1) ? "simd" : "scalar");
+}
+BENCHMARK(BM_SolveOffDesign)
+    ->ArgsProduct({{8, 16, 32, 64}, {0, 1}});
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void BM_RNG_NormalDist(benchmark::State& state) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(RNG_NormalDist(10.0, 2.0, 1));
+  }
+}
+BENCHMARK(BM_RNG_NormalDist);
+
+void BM_XLikely(benchmark::State& state) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(XLikely(0.3, 1));
+  }
+}
+BENCHMARK(BM_XLikely);
+
+const char* curve_functions[] = {"constant", "linear", "power",
+                                 "bounded_power", "step"};
+
+std::vector<double> CurveConstants() {
+  std::vector<double> constants;
+  constants.push_back(0.5);
+  constants.push_back(2.0);
+  constants.push_back(1.0);
+  constants.push_back(0.0);
+  constants.push_back(100.0);
+  return constants;
+}
+
+// Argument selects the curve type
+void BM_CalcYVal(benchmark::State& state) {
+  std::string function = curve_functions[state.range(0)];
+  std::vector<double> constants = CurveConstants();
+  double x_val = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(CalcYVal(function, constants, x_val));
+    x_val += 1;
+  }
+  state.SetLabel(function);
+}
+BENCHMARK(BM_CalcYVal)->DenseRange(0, 4);
+
+// Same curves parsed once, evaluated one point at a time
+void BM_TimeCurve(benchmark::State& state) {
+  TimeCurve curve(curve_functions[state.range(0)], CurveConstants());
+  double x_val = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(curve.Evaluate(x_val));
+    x_val += 1;
+  }
+  state.SetLabel(curve_functions[state.range(0)]);
+}
+BENCHMARK(BM_TimeCurve)->DenseRange(0, 4);
+
+// Whole trajectory of 1000 timesteps per iteration
+void BM_TimeCurveBatch(benchmark::State& state) {
+  TimeCurve curve(curve_functions[state.range(0)], CurveConstants());
+  std::vector<double> x_vals(1000);
+  std::vector<double> y_vals(x_vals.size());
+  for (int t = 0; t < x_vals.size(); t++) {
+    x_vals[t] = t;
+  }
+  for (auto _ : state) {
+    curve.Evaluate(&x_vals[0], &y_vals[0], x_vals.size());
+    benchmark::DoNotOptimize(y_vals.data());
+  }
+  state.SetItemsProcessed(state.iterations() * x_vals.size());
+  state.SetLabel(curve_functions[state.range(0)]);
+}
+BENCHMARK(BM_TimeCurveBatch)->DenseRange(0, 4);
+
+}  // namespace
+}  // namespace mbmore
+
+BENCHMARK_MAIN();